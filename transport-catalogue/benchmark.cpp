@@ -0,0 +1,263 @@
+#include "benchmark.h"
+#include "json_reader.h"
+#include "log_duration.h"
+#include "json_scan.h"
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+
+namespace bench {
+
+namespace {
+
+const size_t MAX_ROUTE_QUERIES = 20000;
+// маршруты одинаковой длины из разных рёбер складываются в разном порядке
+const double TIME_TOLERANCE = 1e-6;
+
+bool AreSameRoutes(const std::optional<std::vector<Item>>& lhs, const std::optional<std::vector<Item>>& rhs) {
+	if (lhs.has_value() != rhs.has_value()) {
+		return false;
+	}
+	if (!lhs) {
+		return true;
+	}
+	if (lhs->size() != rhs->size()) {
+		return false;
+	}
+	for (size_t i = 0; i < lhs->size(); ++i) {
+		const Item& l = lhs->at(i);
+		const Item& r = rhs->at(i);
+		if (l.type != r.type || l.name != r.name || l.time != r.time || l.span_count != r.span_count) {
+			return false;
+		}
+	}
+	return true;
+}
+
+double TotalTime(const std::vector<Item>& items) {
+	double total_time = 0.;
+	for (const Item& item : items) {
+		total_time += item.time;
+	}
+	return total_time;
+}
+
+std::vector<std::pair<std::string_view, std::string_view>> MakeRouteQueries(const RequestHandler& rh) {
+	std::vector<std::string_view> names;
+	for (const auto& [name, stop] : rh.GetAllStopsWithBusesAndSorted()) {
+		names.push_back(name);
+	}
+	std::vector<std::pair<std::string_view, std::string_view>> queries;
+	if (names.empty()) {
+		return queries;
+	}
+	if (names.size() * names.size() <= MAX_ROUTE_QUERIES) {
+		for (std::string_view from : names) {
+			for (std::string_view to : names) {
+				queries.push_back({ from, to });
+			}
+		}
+		return queries;
+	}
+	std::mt19937 generator(42);
+	std::uniform_int_distribution<size_t> distribution(0, names.size() - 1);
+	for (size_t i = 0; i < MAX_ROUTE_QUERIES; ++i) {
+		queries.push_back({ names[distribution(generator)], names[distribution(generator)] });
+	}
+	return queries;
+}
+
+// считает события, чтобы сравнивать сам разбор без построения дерева
+class CountingHandler : public json::Handler {
+public:
+	void StartDict() override {
+		++events_;
+	}
+	void Key(std::string) override {
+		++events_;
+	}
+	void EndDict() override {
+		++events_;
+	}
+	void StartArray() override {
+		++events_;
+	}
+	void EndArray() override {
+		++events_;
+	}
+	void Value(json::Node) override {
+		++events_;
+	}
+
+	size_t GetEvents() const {
+		return events_;
+	}
+
+private:
+	size_t events_ = 0;
+};
+
+} //namespace
+
+void CompareRouterEngines(std::istream& input, std::ostream& output, std::vector<graph::RouterEngine> engines) {
+	if (engines.empty()) {
+		engines = { graph::RouterEngine::ALL_PAIRS, graph::RouterEngine::DIJKSTRA, graph::RouterEngine::CONTRACTION_HIERARCHY };
+	}
+	tr_cat::TransportCatalogue catalogue;
+	JSONReader j_read(catalogue);
+	j_read.ReadBase(input);
+	RequestHandler& rh = j_read.GetRequestHandler();
+	const auto queries = MakeRouteQueries(rh);
+	output << "stops: "sv << catalogue.CountStops() << ", route queries: "sv << queries.size() << std::endl;
+	// таблицу all_pairs оцениваем без построения: на больших сетях её строить слишком долго
+	const size_t vertex_count = catalogue.CountStops() * 2;
+	output << "all_pairs table for "sv << vertex_count << " vertices: "sv
+		<< graph::RoutesInternalData<double>::EstimateMemoryUsage(vertex_count) << " bytes, nested optional rows: "sv
+		<< graph::RoutesInternalData<double>::EstimateNestedMemoryUsage(vertex_count) << " bytes"sv << std::endl;
+
+	std::vector<std::optional<std::vector<Item>>> reference;
+	for (graph::RouterEngine engine : engines) {
+		RouterSettings r_set = j_read.GetRouterSettings();
+		r_set.router_engine_ = engine;
+		const std::string engine_name(RouterEngineName(engine));
+
+		std::optional<TransportRouter> tr_router;
+		{
+			LOG_DURATION_STREAM(engine_name + " build"s, output);
+			tr_router.emplace(catalogue, r_set);
+		}
+		output << engine_name << " routing table memory: "sv << tr_router->GetRouterMemoryUsage() << " bytes"sv << std::endl;
+		std::vector<std::optional<std::vector<Item>>> answers;
+		answers.reserve(queries.size());
+		{
+			LOG_DURATION_STREAM(engine_name + " queries"s, output);
+			for (const auto& [from, to] : queries) {
+				answers.push_back(tr_router->FindRoute(from, to));
+			}
+		}
+		if (reference.empty()) {
+			reference = std::move(answers);
+			continue;
+		}
+		size_t time_mismatches = 0;
+		size_t alternative_routes = 0;
+		for (size_t i = 0; i < queries.size(); ++i) {
+			if (AreSameRoutes(reference[i], answers[i])) {
+				continue;
+			}
+			if (reference[i] && answers[i] && std::abs(TotalTime(*reference[i]) - TotalTime(*answers[i])) < TIME_TOLERANCE) {
+				++alternative_routes;
+			}
+			else {
+				++time_mismatches;
+			}
+		}
+		output << engine_name << " total_time mismatches: "sv << time_mismatches
+			<< ", equal-time alternative routes: "sv << alternative_routes << std::endl;
+	}
+}
+
+void MeasureTimetable(std::istream& input, std::ostream& output) {
+	tr_cat::TransportCatalogue catalogue;
+	JSONReader j_read(catalogue);
+	j_read.ReadBase(input);
+	const RouterSettings& r_set = j_read.GetRouterSettings();
+	const auto queries = MakeRouteQueries(j_read.GetRequestHandler());
+	output << "stops: "sv << catalogue.CountStops() << ", buses with schedule: "sv << j_read.GetBusSchedules().size()
+		<< ", route queries: "sv << queries.size() << std::endl;
+
+	std::optional<Timetable> timetable;
+	{
+		LOG_DURATION_STREAM("timetable build"s, output);
+		timetable.emplace(Timetable::Build(catalogue, r_set.bus_wait_time_, r_set.bus_velocity_, j_read.GetBusSchedules()));
+	}
+	output << "timetable: "sv << timetable->GetData().patterns.size() << " patterns, "sv
+		<< timetable->GetMemoryUsage() << " bytes"sv << std::endl;
+
+	// отправления с 5:00 до 23:00
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<double> departures(5. * 60., 23. * 60.);
+	size_t found = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (const auto& [from, to] : queries) {
+		const StopId from_id = (*catalogue.FindStop(from))->id;
+		const StopId to_id = (*catalogue.FindStop(to))->id;
+		found += timetable->FindRoute(from_id, to_id, departures(generator)).has_value();
+	}
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	output << "timetable queries: "sv << elapsed.count() << " ms, "sv
+		<< (queries.empty() ? 0. : elapsed.count() / queries.size()) << " ms per query, found "sv << found << std::endl;
+}
+
+void CompareJsonParsers(std::istream& input, std::ostream& output) {
+	std::ostringstream text_stream;
+	text_stream << input.rdbuf();
+	const std::string text = text_stream.str();
+	const double megabytes = text.size() / (1024. * 1024.);
+	output << "input: "sv << text.size() << " bytes, scan kernel: "sv << json::detail::GetScanKernelName() << std::endl;
+
+	auto measure = [&output, megabytes](std::string_view name, auto run) {
+		const auto start = std::chrono::steady_clock::now();
+		auto result = run();
+		const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+		output << name << ": "sv << static_cast<int>(seconds.count() * 1000) << " ms, "sv
+			<< megabytes / seconds.count() << " MB/s"sv << std::endl;
+		return std::make_pair(std::move(result), seconds.count());
+	};
+
+	// только токенизация: события без построения json::Node-дерева
+	const auto [stream_events, stream_parse_seconds] = measure("stream parse"sv, [&text] {
+		std::istringstream stream(text);
+		CountingHandler handler;
+		json::Parse(stream, handler);
+		return handler.GetEvents();
+	});
+	const auto [buffer_events, buffer_parse_seconds] = measure("buffer parse"sv, [&text] {
+		CountingHandler handler;
+		json::Parse(std::string_view(text), handler);
+		return handler.GetEvents();
+	});
+	output << "parse speedup: "sv << stream_parse_seconds / buffer_parse_seconds << "x, events "sv
+		<< (stream_events == buffer_events ? "match"sv : "DIFFER"sv) << std::endl;
+
+	// полный документ
+	const auto [stream_doc, stream_seconds] = measure("stream load"sv, [&text] {
+		std::istringstream stream(text);
+		return json::Load(stream);
+	});
+	auto [buffer_doc, buffer_seconds] = measure("buffer load"sv, [&text] {
+		return json::Load(std::string_view(text));
+	});
+	output << "load speedup: "sv << stream_seconds / buffer_seconds << "x, documents "sv
+		<< (stream_doc == buffer_doc ? "match"sv : "DIFFER"sv) << std::endl;
+
+	// документ в арене: разбор и освобождение против дерева json::Node
+	auto [arena_doc, arena_seconds] = measure("arena load"sv, [&text] {
+		return std::make_unique<json::arena::Document>(json::arena::Load(std::string_view(text)));
+	});
+	const json::detail::Arena& arena = arena_doc->GetArena();
+	output << "arena load speedup: "sv << buffer_seconds / arena_seconds << "x over buffer load, document "sv
+		<< (arena_doc->GetRoot().ToNode() == buffer_doc.GetRoot() ? "matches"sv : "DIFFERS"sv)
+		<< ", arena: "sv << arena.GetUsedSize() << " bytes used, "sv << arena.GetReservedSize() << " bytes in "sv
+		<< arena.GetBlockCount() << " block(s)"sv << std::endl;
+
+	auto measure_teardown = [&output](std::string_view name, auto& document) {
+		const auto start = std::chrono::steady_clock::now();
+		document.reset();
+		const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+		output << name << " teardown: "sv << seconds.count() * 1000 << " ms"sv << std::endl;
+	};
+	auto tree_doc = std::make_unique<json::Document>(std::move(buffer_doc));
+	measure_teardown("json::Node tree"sv, tree_doc);
+	measure_teardown("arena"sv, arena_doc);
+}
+
+} //namespace bench
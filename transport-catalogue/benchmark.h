@@ -0,0 +1,24 @@
+#pragma once
+
+#include "router.h"
+
+#include <iostream>
+#include <vector>
+
+namespace bench {
+
+// Читает из input базу в формате make_base и сравнивает движки маршрутизации:
+// время построения, время ответа на выборку запросов Route и совпадение ответов с первым движком.
+// Пустой список engines означает все движки
+void CompareRouterEngines(std::istream& input, std::ostream& output, std::vector<graph::RouterEngine> engines = {});
+
+// Читает из input базу в формате make_base (с запросами Schedule) и меряет построение Timetable
+// и поиск по расписанию на выборке запросов Route со случайным временем отправления
+void MeasureTimetable(std::istream& input, std::ostream& output);
+
+// Читает input целиком и сравнивает скорость разбора потокового json::Load(std::istream&),
+// json::Load(std::string_view) и json::arena::Load, проверяя, что документы совпадают,
+// а также время освобождения дерева json::Node и арены
+void CompareJsonParsers(std::istream& input, std::ostream& output);
+
+} //namespace bench
@@ -0,0 +1,485 @@
+#pragma once
+
+#include "graph.h"
+
+#include <graph.pb.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Contraction hierarchy over DirectedWeightedGraph: vertices are contracted one by one
+// and shortcuts keep the distances between the remaining ones. A query then runs
+// two Dijkstra searches that only go up the hierarchy and meet at the highest vertex of the route
+template <typename Weight>
+class ContractionHierarchy {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    // Arcs [0, graph.GetEdgeCount()) are the graph edges with their own EdgeId,
+    // the rest are shortcuts replacing two consecutive arcs through a contracted vertex
+    struct Arc {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        std::optional<std::pair<EdgeId, EdgeId>> children;
+    };
+
+    struct RouteInfo {
+        Weight weight;
+        std::vector<EdgeId> edges;
+    };
+
+    explicit ContractionHierarchy(const Graph& graph);
+    ContractionHierarchy(const Graph& graph, std::vector<size_t> ranks, std::vector<Arc> shortcuts); //serialization purposes
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+    size_t GetShortcutCount() const;
+
+    // Heap bytes of arcs, ranks and upward adjacency; per-thread search buffers are not counted
+    size_t GetMemoryUsage() const;
+
+    tc_serialize::ContractionHierarchy SerializeHierarchy() const;
+
+private:
+    static constexpr Weight ZERO_WEIGHT{};
+    // witness searches give up after this many vertices and keep the shortcut
+    static constexpr size_t MAX_WITNESS_SETTLED = 200;
+
+    size_t edge_count_ = 0;
+    std::vector<Arc> arcs_;
+    std::vector<size_t> ranks_;
+    std::vector<std::vector<EdgeId>> upward_out_arcs_;
+    std::vector<std::vector<EdgeId>> upward_in_arcs_;
+
+    // Per-vertex search buffers reused between searches, only touched entries are reset
+    struct SearchSpace {
+        std::vector<Weight> weights;
+        std::vector<EdgeId> arcs;
+        std::vector<bool> reached;
+        std::vector<VertexId> touched;
+
+        void Prepare(size_t vertex_count);
+        bool Reach(VertexId vertex, Weight weight, EdgeId arc);
+    };
+
+    // Arcs between vertices not contracted yet, only the lightest one to every neighbour
+    struct ContractionState {
+        std::vector<std::vector<EdgeId>> out_arcs;
+        std::vector<std::vector<EdgeId>> in_arcs;
+        std::vector<int64_t> deleted_neighbors;
+        SearchSpace witness_space;
+    };
+
+    void CopyGraphEdges(const Graph& graph);
+    void Contract(const Graph& graph);
+    void AddLiveArc(ContractionState& state, EdgeId arc_id) const;
+    void RemoveVertex(ContractionState& state, VertexId vertex) const;
+    std::vector<Arc> FindShortcuts(ContractionState& state, VertexId vertex) const;
+    int64_t ComputePriority(const ContractionState& state, VertexId vertex, size_t shortcut_count) const;
+    void FindWitnesses(ContractionState& state, VertexId source, VertexId excluded, Weight max_weight) const;
+    void BuildUpwardArcs();
+    void UnpackArc(EdgeId arc_id, std::vector<EdgeId>& edges) const;
+};
+
+template <typename Weight>
+size_t ContractionHierarchy<Weight>::GetMemoryUsage() const {
+    size_t usage = sizeof(*this) + arcs_.capacity() * sizeof(Arc) + ranks_.capacity() * sizeof(size_t)
+        + (upward_out_arcs_.capacity() + upward_in_arcs_.capacity()) * sizeof(std::vector<EdgeId>);
+    for (const auto* lists : { &upward_out_arcs_, &upward_in_arcs_ }) {
+        for (const std::vector<EdgeId>& list : *lists) {
+            usage += list.capacity() * sizeof(EdgeId);
+        }
+    }
+    return usage;
+}
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph) {
+    CopyGraphEdges(graph);
+    Contract(graph);
+    BuildUpwardArcs();
+}
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph, std::vector<size_t> ranks, std::vector<Arc> shortcuts)
+    : ranks_(std::move(ranks))
+{
+    if (ranks_.size() != graph.GetVertexCount()) {
+        throw std::invalid_argument("Contraction hierarchy doesn't match the graph");
+    }
+    CopyGraphEdges(graph);
+    for (Arc& shortcut : shortcuts) {
+        // a shortcut joins two earlier arcs, so unpacking a route stays in bounds and terminates
+        if (!shortcut.children || shortcut.children->first >= arcs_.size() || shortcut.children->second >= arcs_.size()) {
+            throw std::invalid_argument("Contraction hierarchy shortcut refers to a missing arc");
+        }
+        const Arc& first = arcs_[shortcut.children->first];
+        const Arc& second = arcs_[shortcut.children->second];
+        if (first.from != shortcut.from || first.to != second.from || second.to != shortcut.to) {
+            throw std::invalid_argument("Contraction hierarchy shortcut doesn't match its arcs");
+        }
+        arcs_.push_back(std::move(shortcut));
+    }
+    BuildUpwardArcs();
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::CopyGraphEdges(const Graph& graph) {
+    edge_count_ = graph.GetEdgeCount();
+    arcs_.reserve(edge_count_);
+    for (EdgeId edge_id = 0; edge_id < edge_count_; ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        arcs_.push_back(Arc{ edge.from, edge.to, edge.weight, std::nullopt });
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::Contract(const Graph& graph) {
+    const size_t vertex_count = graph.GetVertexCount();
+    ContractionState state{ std::vector<std::vector<EdgeId>>(vertex_count), std::vector<std::vector<EdgeId>>(vertex_count),
+        std::vector<int64_t>(vertex_count, 0), SearchSpace{} };
+    for (EdgeId arc_id = 0; arc_id < arcs_.size(); ++arc_id) {
+        AddLiveArc(state, arc_id);
+    }
+
+    ranks_.assign(vertex_count, 0);
+    using QueueItem = std::pair<int64_t, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        queue.push({ ComputePriority(state, vertex, FindShortcuts(state, vertex).size()), vertex });
+    }
+
+    size_t next_rank = 0;
+    while (!queue.empty()) {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+        // priorities go stale as neighbours get contracted, so the popped one is checked again
+        std::vector<Arc> shortcuts = FindShortcuts(state, vertex);
+        const int64_t priority = ComputePriority(state, vertex, shortcuts.size());
+        if (!queue.empty() && priority > queue.top().first) {
+            queue.push({ priority, vertex });
+            continue;
+        }
+        ranks_[vertex] = next_rank++;
+        RemoveVertex(state, vertex);
+        for (Arc& shortcut : shortcuts) {
+            arcs_.push_back(std::move(shortcut));
+            AddLiveArc(state, arcs_.size() - 1);
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::AddLiveArc(ContractionState& state, EdgeId arc_id) const {
+    const Arc& arc = arcs_[arc_id];
+    if (arc.from == arc.to) {
+        return;
+    }
+    std::vector<EdgeId>& out_arcs = state.out_arcs[arc.from];
+    const auto it = std::find_if(out_arcs.begin(), out_arcs.end(), [this, &arc](EdgeId live_id) {
+        return arcs_[live_id].to == arc.to;
+    });
+    if (it == out_arcs.end()) {
+        out_arcs.push_back(arc_id);
+        state.in_arcs[arc.to].push_back(arc_id);
+        return;
+    }
+    if (arc.weight < arcs_[*it].weight) {
+        std::vector<EdgeId>& in_arcs = state.in_arcs[arc.to];
+        *std::find(in_arcs.begin(), in_arcs.end(), *it) = arc_id;
+        *it = arc_id;
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::RemoveVertex(ContractionState& state, VertexId vertex) const {
+    for (const EdgeId arc_id : state.out_arcs[vertex]) {
+        const VertexId neighbor = arcs_[arc_id].to;
+        ++state.deleted_neighbors[neighbor];
+        std::vector<EdgeId>& in_arcs = state.in_arcs[neighbor];
+        in_arcs.erase(std::find(in_arcs.begin(), in_arcs.end(), arc_id));
+    }
+    for (const EdgeId arc_id : state.in_arcs[vertex]) {
+        const VertexId neighbor = arcs_[arc_id].from;
+        ++state.deleted_neighbors[neighbor];
+        std::vector<EdgeId>& out_arcs = state.out_arcs[neighbor];
+        out_arcs.erase(std::find(out_arcs.begin(), out_arcs.end(), arc_id));
+    }
+    state.out_arcs[vertex].clear();
+    state.in_arcs[vertex].clear();
+}
+
+template <typename Weight>
+int64_t ContractionHierarchy<Weight>::ComputePriority(const ContractionState& state, VertexId vertex,
+    size_t shortcut_count) const {
+    // edge difference plus the number of contracted neighbours to spread contraction evenly
+    const int64_t removed_arcs = static_cast<int64_t>(state.out_arcs[vertex].size() + state.in_arcs[vertex].size());
+    return static_cast<int64_t>(shortcut_count) - removed_arcs + state.deleted_neighbors[vertex];
+}
+
+template <typename Weight>
+std::vector<typename ContractionHierarchy<Weight>::Arc> ContractionHierarchy<Weight>::FindShortcuts(ContractionState& state,
+    VertexId vertex) const {
+    Weight max_out_weight = ZERO_WEIGHT;
+    for (const EdgeId arc_id : state.out_arcs[vertex]) {
+        max_out_weight = std::max(max_out_weight, arcs_[arc_id].weight);
+    }
+
+    std::vector<Arc> shortcuts;
+    for (const EdgeId in_arc : state.in_arcs[vertex]) {
+        const VertexId source = arcs_[in_arc].from;
+        const Weight in_weight = arcs_[in_arc].weight;
+        FindWitnesses(state, source, vertex, in_weight + max_out_weight);
+        for (const EdgeId out_arc : state.out_arcs[vertex]) {
+            const VertexId target = arcs_[out_arc].to;
+            if (target == source) {
+                continue;
+            }
+            const Weight shortcut_weight = in_weight + arcs_[out_arc].weight;
+            if (state.witness_space.reached[target] && !(shortcut_weight < state.witness_space.weights[target])) {
+                continue;
+            }
+            shortcuts.push_back(Arc{ source, target, shortcut_weight, std::make_pair(in_arc, out_arc) });
+        }
+    }
+    return shortcuts;
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::SearchSpace::Prepare(size_t vertex_count) {
+    if (weights.size() < vertex_count) {
+        weights.resize(vertex_count);
+        arcs.resize(vertex_count);
+        reached.resize(vertex_count, false);
+    }
+    for (const VertexId vertex : touched) {
+        reached[vertex] = false;
+    }
+    touched.clear();
+}
+
+template <typename Weight>
+bool ContractionHierarchy<Weight>::SearchSpace::Reach(VertexId vertex, Weight weight, EdgeId arc) {
+    if (!reached[vertex]) {
+        reached[vertex] = true;
+        touched.push_back(vertex);
+    }
+    else if (!(weight < weights[vertex])) {
+        return false;
+    }
+    weights[vertex] = weight;
+    arcs[vertex] = arc;
+    return true;
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::FindWitnesses(ContractionState& state, VertexId source, VertexId excluded,
+    Weight max_weight) const {
+    // tentative distances are lengths of real paths, so every one of them is a valid witness
+    SearchSpace& space = state.witness_space;
+    space.Prepare(ranks_.size());
+    space.Reach(source, ZERO_WEIGHT, 0);
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    queue.push({ ZERO_WEIGHT, source });
+    size_t settled_count = 0;
+    while (!queue.empty() && settled_count < MAX_WITNESS_SETTLED) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (space.weights[vertex] < weight) {
+            continue;
+        }
+        if (max_weight < weight) {
+            break;
+        }
+        ++settled_count;
+        for (const EdgeId arc_id : state.out_arcs[vertex]) {
+            const Arc& arc = arcs_[arc_id];
+            if (arc.to == excluded) {
+                continue;
+            }
+            if (space.Reach(arc.to, weight + arc.weight, arc_id)) {
+                queue.push({ weight + arc.weight, arc.to });
+            }
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::BuildUpwardArcs() {
+    upward_out_arcs_.assign(ranks_.size(), {});
+    upward_in_arcs_.assign(ranks_.size(), {});
+    for (EdgeId arc_id = 0; arc_id < arcs_.size(); ++arc_id) {
+        const Arc& arc = arcs_[arc_id];
+        if (arc.from >= ranks_.size() || arc.to >= ranks_.size()) {
+            throw std::invalid_argument("Contraction hierarchy doesn't match the graph");
+        }
+        if (ranks_[arc.from] < ranks_[arc.to]) {
+            upward_out_arcs_[arc.from].push_back(arc_id);
+        }
+        else if (ranks_[arc.to] < ranks_[arc.from]) {
+            upward_in_arcs_[arc.to].push_back(arc_id);
+        }
+    }
+    // of parallel arcs only the lightest one (the first of equal ones) can be on a shortest route
+    auto keep_lightest = [this](std::vector<EdgeId>& arc_ids, auto neighbor_of) {
+        std::sort(arc_ids.begin(), arc_ids.end(), [this, &neighbor_of](EdgeId lhs, EdgeId rhs) {
+            const VertexId lhs_neighbor = neighbor_of(arcs_[lhs]);
+            const VertexId rhs_neighbor = neighbor_of(arcs_[rhs]);
+            if (lhs_neighbor != rhs_neighbor) {
+                return lhs_neighbor < rhs_neighbor;
+            }
+            if (arcs_[lhs].weight < arcs_[rhs].weight || arcs_[rhs].weight < arcs_[lhs].weight) {
+                return arcs_[lhs].weight < arcs_[rhs].weight;
+            }
+            return lhs < rhs;
+        });
+        arc_ids.erase(std::unique(arc_ids.begin(), arc_ids.end(), [this, &neighbor_of](EdgeId lhs, EdgeId rhs) {
+            return neighbor_of(arcs_[lhs]) == neighbor_of(arcs_[rhs]);
+        }), arc_ids.end());
+    };
+    for (VertexId vertex = 0; vertex < ranks_.size(); ++vertex) {
+        keep_lightest(upward_out_arcs_[vertex], [](const Arc& arc) { return arc.to; });
+        keep_lightest(upward_in_arcs_[vertex], [](const Arc& arc) { return arc.from; });
+    }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchy<Weight>::RouteInfo> ContractionHierarchy<Weight>::BuildRoute(VertexId from,
+    VertexId to) const {
+    const size_t vertex_count = ranks_.size();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex is out of graph");
+    }
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    // index 0 searches forward from `from`, index 1 searches backward from `to`
+    static thread_local SearchSpace spaces[2];
+    Queue queues[2];
+    spaces[0].Prepare(vertex_count);
+    spaces[1].Prepare(vertex_count);
+    spaces[0].Reach(from, ZERO_WEIGHT, 0);
+    spaces[1].Reach(to, ZERO_WEIGHT, 0);
+    queues[0].push({ ZERO_WEIGHT, from });
+    queues[1].push({ ZERO_WEIGHT, to });
+    const VertexId starts[2] = { from, to };
+
+    std::optional<Weight> best_weight;
+    VertexId meeting_vertex = from;
+
+    while (!queues[0].empty() || !queues[1].empty()) {
+        const size_t side = queues[1].empty() || (!queues[0].empty() && !(queues[1].top() < queues[0].top())) ? 0 : 1;
+        SearchSpace& space = spaces[side];
+        const SearchSpace& other_space = spaces[1 - side];
+        const auto [weight, vertex] = queues[side].top();
+        queues[side].pop();
+        if (space.weights[vertex] < weight) {
+            continue;
+        }
+        if (best_weight && !(weight < *best_weight)) {
+            // nothing cheaper can come from this direction anymore
+            queues[side] = Queue{};
+            continue;
+        }
+        if (other_space.reached[vertex]) {
+            const Weight candidate_weight = weight + other_space.weights[vertex];
+            if (!best_weight || candidate_weight < *best_weight) {
+                best_weight = candidate_weight;
+                meeting_vertex = vertex;
+            }
+        }
+        // stall-on-demand: a higher vertex that reaches this one cheaper means the route doesn't go up from here
+        bool stalled = false;
+        for (const EdgeId arc_id : side == 0 ? upward_in_arcs_[vertex] : upward_out_arcs_[vertex]) {
+            const Arc& arc = arcs_[arc_id];
+            const VertexId higher = side == 0 ? arc.from : arc.to;
+            if (space.reached[higher] && space.weights[higher] + arc.weight < weight) {
+                stalled = true;
+                break;
+            }
+        }
+        if (stalled) {
+            continue;
+        }
+        for (const EdgeId arc_id : side == 0 ? upward_out_arcs_[vertex] : upward_in_arcs_[vertex]) {
+            const Arc& arc = arcs_[arc_id];
+            const VertexId next = side == 0 ? arc.to : arc.from;
+            if (space.Reach(next, weight + arc.weight, arc_id)) {
+                queues[side].push({ weight + arc.weight, next });
+            }
+        }
+    }
+
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> forward_arcs;
+    for (VertexId vertex = meeting_vertex; vertex != starts[0]; vertex = arcs_[spaces[0].arcs[vertex]].from) {
+        forward_arcs.push_back(spaces[0].arcs[vertex]);
+    }
+    std::vector<EdgeId> edges;
+    for (auto it = forward_arcs.rbegin(); it != forward_arcs.rend(); ++it) {
+        UnpackArc(*it, edges);
+    }
+    for (VertexId vertex = meeting_vertex; vertex != starts[1]; vertex = arcs_[spaces[1].arcs[vertex]].to) {
+        UnpackArc(spaces[1].arcs[vertex], edges);
+    }
+    return RouteInfo{ *best_weight, std::move(edges) };
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::UnpackArc(EdgeId arc_id, std::vector<EdgeId>& edges) const {
+    std::vector<EdgeId> stack{ arc_id };
+    while (!stack.empty()) {
+        const Arc& arc = arcs_[stack.back()];
+        if (!arc.children) {
+            edges.push_back(stack.back());
+            stack.pop_back();
+            continue;
+        }
+        stack.pop_back();
+        stack.push_back(arc.children->second);
+        stack.push_back(arc.children->first);
+    }
+}
+
+template <typename Weight>
+size_t ContractionHierarchy<Weight>::GetShortcutCount() const {
+    return arcs_.size() - edge_count_;
+}
+
+template <typename Weight>
+tc_serialize::ContractionHierarchy ContractionHierarchy<Weight>::SerializeHierarchy() const {
+    tc_serialize::ContractionHierarchy hierarchy;
+    for (const size_t rank : ranks_) {
+        hierarchy.add_ranks(rank);
+    }
+    for (EdgeId arc_id = edge_count_; arc_id < arcs_.size(); ++arc_id) {
+        const Arc& arc = arcs_[arc_id];
+        tc_serialize::Shortcut* shortcut = hierarchy.add_shortcuts();
+        shortcut->set_vertex_from(arc.from);
+        shortcut->set_vertex_to(arc.to);
+        shortcut->set_weight(arc.weight);
+        shortcut->set_first_arc(arc.children->first);
+        shortcut->set_second_arc(arc.children->second);
+    }
+    return hierarchy;
+}
+
+}  //namespace graph
@@ -2,27 +2,37 @@
 
 #include "geo.h"
 
+#include <cstdint>
 #include <string>
 #include <vector>
-#include <unordered_set>
 
+using StopId = uint32_t;
+using BusId = uint32_t;
 
 struct Stop {
 	std::string name;
 	geo::Coordinates place{ 0.0, 0.0 };
+	StopId id = 0; //assigned by TransportCatalogue::AddStop
 };
 
 struct Bus {
 	std::string name;
 	std::vector<Stop*> route;
-	std::unordered_set<Stop*> unique_stops;
 	bool is_round = false;
 	std::vector<Stop*> half_route; //will stay empty if is_round == true
+	BusId id = 0; //assigned by TransportCatalogue::AddBus
 };
 
+// расстояние по дорогам от from до to; обратное направление задаётся отдельно
+struct RoadDistance {
+	StopId from = 0;
+	StopId to = 0;
+	int distance = 0;
+};
 
 struct BusStat {
 	double curvature = 0.0;
+	double geo_length = 0.0;
 	int route_length = 0;
 	int stop_count = 0;
 	int unique_stop_count = 0;
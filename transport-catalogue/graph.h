@@ -3,6 +3,8 @@
 #include "ranges.h"
 #include <graph.pb.h>
 #include <cstdlib>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
 namespace graph {
@@ -21,12 +23,16 @@ template <typename Weight>
 class DirectedWeightedGraph {
 private:
     using IncidenceList = std::vector<EdgeId>;
-    using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+    using IncidentEdgesRange = ranges::Range<const EdgeId*>;
 
 public:
     DirectedWeightedGraph() = default;
     explicit DirectedWeightedGraph(size_t vertex_count);
     explicit DirectedWeightedGraph(std::vector<Edge<Weight>> edges, std::vector<IncidenceList> incidence_lists);//for serialization purposes
+    // Read-only view over a memory-mapped base: incidence lists are stored one after another,
+    // the list of vertex v is [incidence_offsets[v], incidence_offsets[v + 1]); storage keeps the memory alive
+    DirectedWeightedGraph(const Edge<Weight>* edges, size_t edge_count, const size_t* incidence_offsets,
+        const EdgeId* incidence_edges, size_t vertex_count, std::shared_ptr<const void> storage);
 
     EdgeId AddEdge(const Edge<Weight>& edge);
 
@@ -35,11 +41,25 @@ public:
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
 
+    // Heap bytes; a memory-mapped graph lives in the base file and takes none
+    size_t GetMemoryUsage() const;
+
     tc_serialize::Graph SerializeGraph() const;
 
 private:
     std::vector<Edge<Weight>> edges_;
     std::vector<IncidenceList> incidence_lists_;
+
+    const Edge<Weight>* mapped_edges_ = nullptr;
+    size_t mapped_edge_count_ = 0;
+    const size_t* mapped_incidence_offsets_ = nullptr;
+    const EdgeId* mapped_incidence_edges_ = nullptr;
+    size_t mapped_vertex_count_ = 0;
+    std::shared_ptr<const void> mapped_storage_;
+
+    bool IsMapped() const {
+        return mapped_incidence_offsets_ != nullptr;
+    }
 };
 
 template <typename Weight>
@@ -49,6 +69,17 @@ DirectedWeightedGraph<Weight>::DirectedWeightedGraph(std::vector<Edge<Weight>> e
 
 }
 
+template <typename Weight>
+DirectedWeightedGraph<Weight>::DirectedWeightedGraph(const Edge<Weight>* edges, size_t edge_count,
+    const size_t* incidence_offsets, const EdgeId* incidence_edges, size_t vertex_count, std::shared_ptr<const void> storage)
+    : mapped_edges_(edges)
+    , mapped_edge_count_(edge_count)
+    , mapped_incidence_offsets_(incidence_offsets)
+    , mapped_incidence_edges_(incidence_edges)
+    , mapped_vertex_count_(vertex_count)
+    , mapped_storage_(std::move(storage)) {
+}
+
 template <typename Weight>
 DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
     : incidence_lists_(vertex_count) {
@@ -56,6 +87,9 @@ DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
 
 template <typename Weight>
 EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+    if (IsMapped()) {
+        throw std::logic_error("Can't add an edge to a memory-mapped graph");
+    }
     edges_.push_back(edge);
     const EdgeId id = edges_.size() - 1;
     incidence_lists_.at(edge.from).push_back(id);
@@ -64,37 +98,61 @@ EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
 
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+    return IsMapped() ? mapped_vertex_count_ : incidence_lists_.size();
+}
+
+template <typename Weight>
+size_t DirectedWeightedGraph<Weight>::GetMemoryUsage() const {
+    size_t usage = sizeof(*this) + edges_.capacity() * sizeof(Edge<Weight>) + incidence_lists_.capacity() * sizeof(IncidenceList);
+    for (const IncidenceList& list : incidence_lists_) {
+        usage += list.capacity() * sizeof(EdgeId);
+    }
+    return usage;
 }
 
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
-    return edges_.size();
+    return IsMapped() ? mapped_edge_count_ : edges_.size();
 }
 
 template <typename Weight>
 const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
+    if (IsMapped()) {
+        if (edge_id >= mapped_edge_count_) {
+            throw std::out_of_range("Edge id is out of range");
+        }
+        return mapped_edges_[edge_id];
+    }
     return edges_.at(edge_id);
 }
 
 template <typename Weight>
 typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-    return ranges::AsRange(incidence_lists_.at(vertex));
+    if (IsMapped()) {
+        if (vertex >= mapped_vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        return ranges::Range{ mapped_incidence_edges_ + mapped_incidence_offsets_[vertex],
+            mapped_incidence_edges_ + mapped_incidence_offsets_[vertex + 1] };
+    }
+    const IncidenceList& incidence_list = incidence_lists_.at(vertex);
+    return ranges::Range{ incidence_list.data(), incidence_list.data() + incidence_list.size() };
 }
 
 template <typename Weight>
 tc_serialize::Graph DirectedWeightedGraph<Weight>::SerializeGraph() const {
     tc_serialize::Graph serial_graph;
-    for (const Edge<Weight>& edge : edges_) {
+    for (EdgeId edge_id = 0; edge_id < GetEdgeCount(); ++edge_id) {
+        const Edge<Weight>& edge = GetEdge(edge_id);
         tc_serialize::Edge* s_edge = serial_graph.add_edges();
         s_edge->set_weight(edge.weight);
         s_edge->set_vertex_from(edge.from);
         s_edge->set_vertex_to(edge.to);
     }
-    for (const IncidenceList& inc_list : incidence_lists_) {
+    for (VertexId vertex = 0; vertex < GetVertexCount(); ++vertex) {
         tc_serialize::IncidenceList* list = serial_graph.add_incidence_lists();
-        for (EdgeId edge_id : inc_list) {
+        for (EdgeId edge_id : GetIncidentEdges(vertex)) {
             list->add_edge_id_incidence_list(edge_id); //wow, i could do that?
         }
     }
@@ -1,4 +1,12 @@
 #include "json.h"
+#include "json_scan.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <utility>
 
 namespace json {
 
@@ -448,14 +456,917 @@ void PrintNode(const Node& node, const PrintContext& ctx) {
         node.GetValue());
 }
 
+void ParseNode(std::istream& input, Handler& handler);
+
+void ParseArray(std::istream& input, Handler& handler) {
+    handler.StartArray();
+    for (char c; input >> c && c != ']';) {
+        if (c != ',') {
+            input.putback(c);
+        }
+        ParseNode(input, handler);
+    }
+    if (!input) {
+        throw ParsingError("Array parsing error"s);
+    }
+    handler.EndArray();
+}
+
+void ParseDict(std::istream& input, Handler& handler) {
+    handler.StartDict();
+    for (char c; input >> c && c != '}';) {
+        if (c == '"') {
+            std::string key = LoadString(input).AsString();
+            if (input >> c && c == ':') {
+                handler.Key(std::move(key));
+                ParseNode(input, handler);
+            }
+            else {
+                throw ParsingError(": is expected but '"s + c + "' has been found"s);
+            }
+        }
+        else if (c != ',') {
+            throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+        }
+    }
+    if (!input) {
+        throw ParsingError("Dictionary parsing error"s);
+    }
+    handler.EndDict();
+}
+
+void ParseNode(std::istream& input, Handler& handler) {
+    char c;
+    if (!(input >> c)) {
+        throw ParsingError("Unexpected EOF"s);
+    }
+    switch (c) {
+    case '[':
+        ParseArray(input, handler);
+        return;
+    case '{':
+        ParseDict(input, handler);
+        return;
+    case '"':
+        handler.Value(LoadString(input));
+        return;
+    case 't':
+        [[fallthrough]];
+    case 'f':
+        input.putback(c);
+        handler.Value(LoadBool(input));
+        return;
+    case 'n':
+        input.putback(c);
+        handler.Value(LoadNull(input));
+        return;
+    default:
+        input.putback(c);
+        handler.Value(LoadNumber(input));
+        return;
+    }
+}
+
+// Тот же разбор, что и LoadNode, но по буферу в памяти: без виртуальных вызовов потока на каждый символ,
+// пробелы и обычные символы строк пропускаются блоками, числа читает std::from_chars
+class BufferLoader {
+public:
+    explicit BufferLoader(std::string_view input)
+        : pos_(input.data())
+        , end_(input.data() + input.size()) {
+    }
+
+    Node LoadNode() {
+        char c;
+        if (!ReadChar(c)) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        switch (c) {
+        case '[':
+            return LoadArray();
+        case '{':
+            return LoadDict();
+        case '"':
+            return Node(LoadString());
+        case 't':
+            [[fallthrough]];
+        case 'f':
+            --pos_;
+            return LoadBool();
+        case 'n':
+            --pos_;
+            return LoadNull();
+        default:
+            --pos_;
+            return LoadNumber();
+        }
+    }
+
+    void ParseNode(Handler& handler) {
+        char c;
+        if (!ReadChar(c)) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        switch (c) {
+        case '[':
+            ParseArray(handler);
+            return;
+        case '{':
+            ParseDict(handler);
+            return;
+        case '"':
+            handler.Value(Node(LoadString()));
+            return;
+        case 't':
+            [[fallthrough]];
+        case 'f':
+            --pos_;
+            handler.Value(LoadBool());
+            return;
+        case 'n':
+            --pos_;
+            handler.Value(LoadNull());
+            return;
+        default:
+            --pos_;
+            handler.Value(LoadNumber());
+            return;
+        }
+    }
+
+    // Стеки values и members общие для всех уровней вложенности: элементы открытых контейнеров
+    // копятся в них, а при закрытии контейнера переносятся в арену одним непрерывным куском
+    struct ArenaContext {
+        detail::Arena& arena;
+        std::vector<arena::Node> values;
+        std::vector<arena::Member> members;
+        std::string string_buffer;
+    };
+
+    arena::Node LoadArenaNode(ArenaContext& context) {
+        char c;
+        if (!ReadChar(c)) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        switch (c) {
+        case '[':
+            return LoadArenaArray(context);
+        case '{':
+            return LoadArenaDict(context);
+        case '"':
+            return LoadArenaString(context);
+        case 't':
+            [[fallthrough]];
+        case 'f':
+            --pos_;
+            return LoadBool().AsBool();
+        case 'n':
+            --pos_;
+            LoadNull();
+            return nullptr;
+        default: {
+            --pos_;
+            const Node number = LoadNumber();
+            if (number.IsInt()) {
+                return number.AsInt();
+            }
+            return number.AsDouble();
+        }
+        }
+    }
+
+private:
+    const char* pos_;
+    const char* end_;
+
+    template <typename T>
+    static T* CopyToArena(detail::Arena& arena, const T* data, size_t size) {
+        if (size > std::numeric_limits<uint32_t>::max()) {
+            throw ParsingError("Too large value"s);
+        }
+        T* result = static_cast<T*>(arena.Allocate(sizeof(T) * size, alignof(T)));
+        if (size != 0) {
+            std::memcpy(static_cast<void*>(result), data, sizeof(T) * size);
+        }
+        return result;
+    }
+
+    std::string_view LoadArenaStringView(ArenaContext& context) {
+        context.string_buffer.clear();
+        ReadString(context.string_buffer);
+        const std::string& s = context.string_buffer;
+        return { CopyToArena(context.arena, s.data(), s.size()), s.size() };
+    }
+
+    arena::Node LoadArenaString(ArenaContext& context) {
+        return LoadArenaStringView(context);
+    }
+
+    arena::Node LoadArenaArray(ArenaContext& context) {
+        const size_t first = context.values.size();
+        char c;
+        bool has_char;
+        while ((has_char = ReadChar(c)) && c != ']') {
+            if (c != ',') {
+                --pos_;
+            }
+            const arena::Node node = LoadArenaNode(context);
+            context.values.push_back(node);
+        }
+        if (!has_char) {
+            throw ParsingError("Array parsing error"s);
+        }
+        const size_t size = context.values.size() - first;
+        const arena::Node* data = CopyToArena(context.arena, context.values.data() + first, size);
+        context.values.resize(first);
+        return arena::Array(data, size);
+    }
+
+    arena::Node LoadArenaDict(ArenaContext& context) {
+        const size_t first = context.members.size();
+        char c;
+        bool has_char;
+        while ((has_char = ReadChar(c)) && c != '}') {
+            if (c == '"') {
+                const std::string_view key = LoadArenaStringView(context);
+                if (ReadChar(c) && c == ':') {
+                    const arena::Node value = LoadArenaNode(context);
+                    context.members.push_back({ key, value });
+                }
+                else {
+                    throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                }
+            }
+            else if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+        if (!has_char) {
+            throw ParsingError("Dictionary parsing error"s);
+        }
+
+        const auto begin = context.members.begin() + first;
+        std::sort(begin, context.members.end(), [](const arena::Member& lhs, const arena::Member& rhs) {
+            return lhs.first < rhs.first;
+        });
+        const auto duplicate = std::adjacent_find(begin, context.members.end(),
+            [](const arena::Member& lhs, const arena::Member& rhs) {
+                return lhs.first == rhs.first;
+            });
+        if (duplicate != context.members.end()) {
+            throw ParsingError("Duplicate key '"s + std::string(duplicate->first) + "' have been found");
+        }
+        const size_t size = context.members.size() - first;
+        const arena::Member* data = CopyToArena(context.arena, context.members.data() + first, size);
+        context.members.resize(first);
+        return arena::Dict(data, size);
+    }
+
+    // аналог input >> c: пропускает пробельные символы и читает следующий
+    bool ReadChar(char& c) {
+        pos_ = detail::SkipWhitespace(pos_, end_);
+        if (pos_ == end_) {
+            return false;
+        }
+        c = *pos_++;
+        return true;
+    }
+
+    int Peek() const {
+        return pos_ == end_ ? std::char_traits<char>::eof() : static_cast<unsigned char>(*pos_);
+    }
+
+    Node LoadArray() {
+        Array result;
+        char c;
+        bool has_char;
+        while ((has_char = ReadChar(c)) && c != ']') {
+            if (c != ',') {
+                --pos_;
+            }
+            result.push_back(LoadNode());
+        }
+        if (!has_char) {
+            throw ParsingError("Array parsing error"s);
+        }
+        return Node(std::move(result));
+    }
+
+    Node LoadDict() {
+        Dict dict;
+        char c;
+        bool has_char;
+        while ((has_char = ReadChar(c)) && c != '}') {
+            if (c == '"') {
+                std::string key = LoadString();
+                if (ReadChar(c) && c == ':') {
+                    const auto [it, inserted] = dict.try_emplace(std::move(key));
+                    if (!inserted) {
+                        throw ParsingError("Duplicate key '"s + it->first + "' have been found");
+                    }
+                    it->second = LoadNode();
+                }
+                else {
+                    throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                }
+            }
+            else if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+        if (!has_char) {
+            throw ParsingError("Dictionary parsing error"s);
+        }
+        return Node(std::move(dict));
+    }
+
+    void ParseArray(Handler& handler) {
+        handler.StartArray();
+        char c;
+        bool has_char;
+        while ((has_char = ReadChar(c)) && c != ']') {
+            if (c != ',') {
+                --pos_;
+            }
+            ParseNode(handler);
+        }
+        if (!has_char) {
+            throw ParsingError("Array parsing error"s);
+        }
+        handler.EndArray();
+    }
+
+    void ParseDict(Handler& handler) {
+        handler.StartDict();
+        char c;
+        bool has_char;
+        while ((has_char = ReadChar(c)) && c != '}') {
+            if (c == '"') {
+                std::string key = LoadString();
+                if (ReadChar(c) && c == ':') {
+                    handler.Key(std::move(key));
+                    ParseNode(handler);
+                }
+                else {
+                    throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                }
+            }
+            else if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+        if (!has_char) {
+            throw ParsingError("Dictionary parsing error"s);
+        }
+        handler.EndDict();
+    }
+
+    std::string LoadString() {
+        std::string s;
+        ReadString(s);
+        return s;
+    }
+
+    // дописывает в s строку после открывающей кавычки
+    void ReadString(std::string& s) {
+        while (true) {
+            const char* special = detail::FindStringSpecial(pos_, end_);
+            s.append(pos_, special);
+            pos_ = special;
+            if (pos_ == end_) {
+                throw ParsingError("String parsing error");
+            }
+            const char ch = *pos_++;
+            if (ch == '"') {
+                break;
+            }
+            if (ch == '\n' || ch == '\r') {
+                throw ParsingError("Unexpected end of line"s);
+            }
+            if (pos_ == end_) {
+                throw ParsingError("String parsing error");
+            }
+            const char escaped_char = *pos_++;
+            switch (escaped_char) {
+            case 'n':
+                s.push_back('\n');
+                break;
+            case 't':
+                s.push_back('\t');
+                break;
+            case 'r':
+                s.push_back('\r');
+                break;
+            case '"':
+                s.push_back('"');
+                break;
+            case '\\':
+                s.push_back('\\');
+                break;
+            default:
+                throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+            }
+        }
+    }
+
+    std::string_view LoadLiteral() {
+        const char* begin = pos_;
+        while (std::isalpha(Peek())) {
+            ++pos_;
+        }
+        return { begin, static_cast<size_t>(pos_ - begin) };
+    }
+
+    Node LoadBool() {
+        const std::string_view s = LoadLiteral();
+        if (s == "true"sv) {
+            return Node{ true };
+        }
+        else if (s == "false"sv) {
+            return Node{ false };
+        }
+        else {
+            throw ParsingError("Failed to parse '"s + std::string(s) + "' as bool"s);
+        }
+    }
+
+    Node LoadNull() {
+        if (const std::string_view literal = LoadLiteral(); literal == "null"sv) {
+            return Node{ nullptr };
+        }
+        else {
+            throw ParsingError("Failed to parse '"s + std::string(literal) + "' as null"s);
+        }
+    }
+
+    Node LoadNumber() {
+        const char* begin = pos_;
+
+        auto is_digit = [this] {
+            return pos_ != end_ && *pos_ >= '0' && *pos_ <= '9';
+        };
+        auto read_digits = [this, is_digit] {
+            if (!is_digit()) {
+                throw ParsingError("A digit is expected"s);
+            }
+            while (is_digit()) {
+                ++pos_;
+            }
+        };
+
+        if (Peek() == '-') {
+            ++pos_;
+        }
+        if (Peek() == '0') {
+            ++pos_;
+        }
+        else {
+            read_digits();
+        }
+
+        bool is_int = true;
+        if (Peek() == '.') {
+            ++pos_;
+            read_digits();
+            is_int = false;
+        }
+
+        if (int ch = Peek(); ch == 'e' || ch == 'E') {
+            ++pos_;
+            if (ch = Peek(); ch == '+' || ch == '-') {
+                ++pos_;
+            }
+            read_digits();
+            is_int = false;
+        }
+
+        if (is_int) {
+            int int_value = 0;
+            if (const auto [ptr, ec] = std::from_chars(begin, pos_, int_value); ec == std::errc{} && ptr == pos_) {
+                return int_value;
+            }
+            // при переполнении int пробуем double, как и LoadNumber
+        }
+        double double_value = 0.;
+        if (const auto [ptr, ec] = std::from_chars(begin, pos_, double_value); ec == std::errc{} && ptr == pos_) {
+            return double_value;
+        }
+        throw ParsingError("Failed to convert "s + std::string(begin, pos_) + " to number"s);
+    }
+};
+
 }  //namespace
 
 Document Load(std::istream& input) {
     return Document{ LoadNode(input) };
 }
 
+Document Load(std::string_view input) {
+    return Document{ BufferLoader(input).LoadNode() };
+}
+
+void NodeBuilder::StartDict() {
+    containers_.emplace_back(Dict{});
+}
+
+void NodeBuilder::Key(std::string key) {
+    if (containers_.empty() || !containers_.back().IsDict()) {
+        throw ParsingError("Key outside of a dictionary"s);
+    }
+    keys_.push_back(std::move(key));
+}
+
+void NodeBuilder::EndDict() {
+    if (containers_.empty() || !containers_.back().IsDict()) {
+        throw ParsingError("Unexpected end of dictionary"s);
+    }
+    Node dict = std::move(containers_.back());
+    containers_.pop_back();
+    AddNode(std::move(dict));
+}
+
+void NodeBuilder::StartArray() {
+    containers_.emplace_back(Array{});
+}
+
+void NodeBuilder::EndArray() {
+    if (containers_.empty() || !containers_.back().IsArray()) {
+        throw ParsingError("Unexpected end of array"s);
+    }
+    Node array = std::move(containers_.back());
+    containers_.pop_back();
+    AddNode(std::move(array));
+}
+
+void NodeBuilder::Value(Node value) {
+    AddNode(std::move(value));
+}
+
+bool NodeBuilder::IsComplete() const {
+    return root_.has_value();
+}
+
+Node NodeBuilder::Extract() {
+    if (!root_) {
+        throw ParsingError("Value is not complete"s);
+    }
+    Node result = std::move(*root_);
+    root_.reset();
+    return result;
+}
+
+void NodeBuilder::AddNode(Node node) {
+    if (containers_.empty()) {
+        if (root_) {
+            throw ParsingError("Previous value has not been extracted"s);
+        }
+        root_ = std::move(node);
+        return;
+    }
+    Node::Value& container = containers_.back().GetValue();
+    if (std::holds_alternative<Array>(container)) {
+        std::get<Array>(container).push_back(std::move(node));
+        return;
+    }
+    if (keys_.empty()) {
+        throw ParsingError("Dictionary value without a key"s);
+    }
+    const auto [it, inserted] = std::get<Dict>(container).try_emplace(std::move(keys_.back()), std::move(node));
+    if (!inserted) {
+        throw ParsingError("Duplicate key '"s + it->first + "' have been found");
+    }
+    keys_.pop_back();
+}
+
+void Parse(std::istream& input, Handler& handler) {
+    ParseNode(input, handler);
+}
+
+void Parse(std::string_view input, Handler& handler) {
+    BufferLoader(input).ParseNode(handler);
+}
+
 void Print(const Document& doc, std::ostream& output) {
     PrintNode(doc.GetRoot(), PrintContext{ output });
 }
 
+namespace detail {
+
+Arena::Arena(size_t first_block_size)
+    : first_block_size_(first_block_size) {
+}
+
+Arena::~Arena() {
+    Release();
+}
+
+Arena::Arena(Arena&& other) noexcept
+    : last_block_(std::exchange(other.last_block_, nullptr))
+    , pos_(std::exchange(other.pos_, nullptr))
+    , end_(std::exchange(other.end_, nullptr))
+    , first_block_size_(other.first_block_size_)
+    , used_size_(std::exchange(other.used_size_, 0)) {
+}
+
+Arena& Arena::operator=(Arena&& other) noexcept {
+    if (this != &other) {
+        Release();
+        last_block_ = std::exchange(other.last_block_, nullptr);
+        pos_ = std::exchange(other.pos_, nullptr);
+        end_ = std::exchange(other.end_, nullptr);
+        first_block_size_ = other.first_block_size_;
+        used_size_ = std::exchange(other.used_size_, 0);
+    }
+    return *this;
+}
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+    auto padding = [this, alignment] {
+        return (alignment - reinterpret_cast<std::uintptr_t>(pos_) % alignment) % alignment;
+    };
+    if (pos_ == nullptr || static_cast<size_t>(end_ - pos_) < padding() + size) {
+        AddBlock(size + alignment);
+    }
+    std::byte* result = pos_ + padding();
+    pos_ = result + size;
+    used_size_ += size;
+    return result;
+}
+
+size_t Arena::GetUsedSize() const {
+    return used_size_;
+}
+
+size_t Arena::GetReservedSize() const {
+    size_t result = 0;
+    for (const BlockHeader* block = last_block_; block != nullptr; block = block->previous) {
+        result += block->size;
+    }
+    return result;
+}
+
+size_t Arena::GetBlockCount() const {
+    size_t result = 0;
+    for (const BlockHeader* block = last_block_; block != nullptr; block = block->previous) {
+        ++result;
+    }
+    return result;
+}
+
+void Arena::AddBlock(size_t min_size) {
+    const size_t MIN_BLOCK_SIZE = 4096;
+    // первый блок заказанного размера, каждый следующий вдвое больше предыдущего
+    size_t size = last_block_ == nullptr ? first_block_size_ : last_block_->size * 2;
+    size = std::max({ size, min_size + sizeof(BlockHeader), MIN_BLOCK_SIZE });
+    auto* block = new (::operator new(size)) BlockHeader{ last_block_, size };
+    last_block_ = block;
+    pos_ = reinterpret_cast<std::byte*>(block) + sizeof(BlockHeader);
+    end_ = reinterpret_cast<std::byte*>(block) + size;
+}
+
+void Arena::Release() {
+    while (last_block_ != nullptr) {
+        BlockHeader* previous = last_block_->previous;
+        ::operator delete(last_block_);
+        last_block_ = previous;
+    }
+    pos_ = end_ = nullptr;
+    used_size_ = 0;
+}
+
+}  //namespace detail
+
+namespace arena {
+using namespace std::literals;
+
+Array::Array(const Node* data, size_t size)
+    : data_(data)
+    , size_(size) {
+}
+
+const Node* Array::begin() const {
+    return data_;
+}
+
+const Node* Array::end() const {
+    return data_ + size_;
+}
+
+size_t Array::size() const {
+    return size_;
+}
+
+bool Array::empty() const {
+    return size_ == 0;
+}
+
+const Node& Array::operator[](size_t index) const {
+    return data_[index];
+}
+
+const Node& Array::at(size_t index) const {
+    if (index >= size_) {
+        throw std::out_of_range("Array index is out of range"s);
+    }
+    return data_[index];
+}
+
+Dict::Dict(const Member* members, size_t size)
+    : members_(members)
+    , size_(size) {
+}
+
+const Member* Dict::begin() const {
+    return members_;
+}
+
+const Member* Dict::end() const {
+    return members_ + size_;
+}
+
+size_t Dict::size() const {
+    return size_;
+}
+
+bool Dict::empty() const {
+    return size_ == 0;
+}
+
+const Node& Dict::at(std::string_view key) const {
+    const Member* member = find(key);
+    if (member == end()) {
+        throw std::out_of_range("Key '"s + std::string(key) + "' is not found"s);
+    }
+    return member->second;
+}
+
+size_t Dict::count(std::string_view key) const {
+    return find(key) == end() ? 0 : 1;
+}
+
+const Member* Dict::find(std::string_view key) const {
+    const Member* member = std::lower_bound(begin(), end(), key, [](const Member& lhs, std::string_view rhs) {
+        return lhs.first < rhs;
+    });
+    return member != end() && member->first == key ? member : end();
+}
+
+Node::Node(std::nullptr_t) {
+}
+
+Node::Node(bool value)
+    : type_(Type::BOOL) {
+    bool_ = value;
+}
+
+Node::Node(int value)
+    : type_(Type::INT) {
+    int_ = value;
+}
+
+Node::Node(double value)
+    : type_(Type::DOUBLE) {
+    double_ = value;
+}
+
+Node::Node(std::string_view value)
+    : type_(Type::STRING)
+    , size_(static_cast<uint32_t>(value.size())) {
+    string_ = value.data();
+}
+
+Node::Node(Array value)
+    : type_(Type::ARRAY)
+    , size_(static_cast<uint32_t>(value.size())) {
+    array_ = value.begin();
+}
+
+Node::Node(Dict value)
+    : type_(Type::DICT)
+    , size_(static_cast<uint32_t>(value.size())) {
+    dict_ = value.begin();
+}
+
+bool Node::IsInt() const {
+    return type_ == Type::INT;
+}
+int Node::AsInt() const {
+    if (!IsInt()) {
+        throw std::logic_error("Not an int"s);
+    }
+    return int_;
+}
+
+bool Node::IsPureDouble() const {
+    return type_ == Type::DOUBLE;
+}
+bool Node::IsDouble() const {
+    return IsInt() || IsPureDouble();
+}
+double Node::AsDouble() const {
+    if (!IsDouble()) {
+        throw std::logic_error("Not a double"s);
+    }
+    return IsPureDouble() ? double_ : int_;
+}
+
+bool Node::IsBool() const {
+    return type_ == Type::BOOL;
+}
+bool Node::AsBool() const {
+    if (!IsBool()) {
+        throw std::logic_error("Not a bool"s);
+    }
+    return bool_;
+}
+
+bool Node::IsNull() const {
+    return type_ == Type::NULL_VALUE;
+}
+
+bool Node::IsArray() const {
+    return type_ == Type::ARRAY;
+}
+Array Node::AsArray() const {
+    if (!IsArray()) {
+        throw std::logic_error("Not an array"s);
+    }
+    return Array(array_, size_);
+}
+
+bool Node::IsString() const {
+    return type_ == Type::STRING;
+}
+std::string_view Node::AsString() const {
+    if (!IsString()) {
+        throw std::logic_error("Not a string"s);
+    }
+    return { string_, size_ };
+}
+
+bool Node::IsDict() const {
+    return type_ == Type::DICT;
+}
+Dict Node::AsDict() const {
+    if (!IsDict()) {
+        throw std::logic_error("Not a dict"s);
+    }
+    return Dict(dict_, size_);
+}
+
+json::Node Node::ToNode() const {
+    switch (type_) {
+    case Type::ARRAY: {
+        json::Array result;
+        result.reserve(size_);
+        for (const Node& node : AsArray()) {
+            result.push_back(node.ToNode());
+        }
+        return json::Node(std::move(result));
+    }
+    case Type::DICT: {
+        json::Dict result;
+        for (const auto& [key, node] : AsDict()) {
+            result.emplace_hint(result.end(), key, node.ToNode());
+        }
+        return json::Node(std::move(result));
+    }
+    case Type::BOOL:
+        return bool_;
+    case Type::INT:
+        return int_;
+    case Type::DOUBLE:
+        return double_;
+    case Type::STRING:
+        return std::string(AsString());
+    default:
+        return nullptr;
+    }
+}
+
+Document::Document(detail::Arena arena, Node root)
+    : arena_(std::move(arena))
+    , root_(root) {
+}
+
+const Node& Document::GetRoot() const {
+    return root_;
+}
+
+const detail::Arena& Document::GetArena() const {
+    return arena_;
+}
+
+Document Load(std::string_view input) {
+    // на типичных запросах арена в 2-3 раза больше текста; неиспользованная часть
+    // большого блока не занимает физическую память, а второй блок нужен редко
+    const size_t ARENA_TO_INPUT_RATIO = 4;
+    detail::Arena arena(input.size() * ARENA_TO_INPUT_RATIO);
+    BufferLoader::ArenaContext context{ arena, {}, {}, {} };
+    const Node root = BufferLoader(input).LoadArenaNode(context);
+    return Document(std::move(arena), root);
+}
+
+}  //namespace arena
+
 }  //namespace json
\ No newline at end of file
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 #include <iterator>
@@ -75,7 +79,221 @@ inline bool operator!=(const Document& lhs, const Document& rhs) {
 }
 
 Document Load(std::istream& input);
+// Разбирает документ целиком лежащий в памяти (например, в отображённом файле), заметно быстрее потокового
+Document Load(std::string_view input);
+
+// Получает события потокового разбора json::Parse в порядке их появления во входных данных
+class Handler {
+public:
+    virtual ~Handler() = default;
+
+    virtual void StartDict() = 0;
+    virtual void Key(std::string key) = 0;
+    virtual void EndDict() = 0;
+    virtual void StartArray() = 0;
+    virtual void EndArray() = 0;
+    // null, bool, число или строка
+    virtual void Value(Node value) = 0;
+};
+
+// Собирает Node из событий одного значения, например одного элемента большого массива
+class NodeBuilder : public Handler {
+public:
+    void StartDict() override;
+    void Key(std::string key) override;
+    void EndDict() override;
+    void StartArray() override;
+    void EndArray() override;
+    void Value(Node value) override;
+
+    // значение закрыто и его можно забрать
+    bool IsComplete() const;
+    Node Extract();
+
+private:
+    std::vector<Node> containers_;
+    std::vector<std::string> keys_;
+    std::optional<Node> root_;
+
+    void AddNode(Node node);
+};
+
+// Разбирает input, не строя документ: память нужна только под текущие строку или число.
+// Повторы ключей не проверяются, это делает обработчик (NodeBuilder их отвергает)
+void Parse(std::istream& input, Handler& handler);
+void Parse(std::string_view input, Handler& handler);
 
 void Print(const Document& doc, std::ostream& output);
 
+namespace detail {
+
+// Монотонная арена: память только выделяется и освобождается вся сразу вместе с ареной.
+// Блоки связаны в список, так что при удачном размере первого блока разрушение - одно освобождение
+class Arena {
+public:
+    explicit Arena(size_t first_block_size = 0);
+    ~Arena();
+
+    Arena(Arena&& other) noexcept;
+    Arena& operator=(Arena&& other) noexcept;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment);
+
+    // сколько байт занято и сколько получено у системы
+    size_t GetUsedSize() const;
+    size_t GetReservedSize() const;
+    size_t GetBlockCount() const;
+
+private:
+    struct BlockHeader {
+        BlockHeader* previous = nullptr;
+        size_t size = 0;
+    };
+
+    BlockHeader* last_block_ = nullptr;
+    std::byte* pos_ = nullptr;
+    std::byte* end_ = nullptr;
+    size_t first_block_size_ = 0;
+    size_t used_size_ = 0;
+
+    void AddBlock(size_t min_size);
+    void Release();
+};
+
+}  //namespace detail
+
+// Документ только для чтения, целиком лежащий в одной арене: строки - string_view в арену,
+// массивы и словари - непрерывные диапазоны. Словарь отсортирован по ключу, поэтому
+// AsDict().at()/count() ищут двоичным поиском и ведут себя как у std::map, а обход идёт в том же порядке
+namespace arena {
+
+class Node;
+struct Member;
+
+class Array {
+public:
+    Array() = default;
+    Array(const Node* data, size_t size);
+
+    const Node* begin() const;
+    const Node* end() const;
+    size_t size() const;
+    bool empty() const;
+
+    const Node& operator[](size_t index) const;
+    // std::out_of_range, если индекса нет
+    const Node& at(size_t index) const;
+
+private:
+    const Node* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+class Dict {
+public:
+    Dict() = default;
+    // members должны быть отсортированы по ключу без повторов
+    Dict(const Member* members, size_t size);
+
+    const Member* begin() const;
+    const Member* end() const;
+    size_t size() const;
+    bool empty() const;
+
+    // std::out_of_range, если ключа нет
+    const Node& at(std::string_view key) const;
+    size_t count(std::string_view key) const;
+    // end(), если ключа нет
+    const Member* find(std::string_view key) const;
+
+private:
+    const Member* members_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Узел хранит значение или ссылку на данные в арене и копируется без выделения памяти
+class Node final {
+public:
+    Node() = default;
+    Node(std::nullptr_t);
+    Node(bool value);
+    Node(int value);
+    Node(double value);
+    // value должна жить в той же арене, что и узел
+    Node(std::string_view value);
+    Node(Array value);
+    Node(Dict value);
+
+    bool IsInt() const;
+    int AsInt() const;
+
+    bool IsPureDouble() const;
+    bool IsDouble() const;
+    double AsDouble() const;
+
+    bool IsBool() const;
+    bool AsBool() const;
+
+    bool IsNull() const;
+
+    bool IsArray() const;
+    Array AsArray() const;
+
+    bool IsString() const;
+    std::string_view AsString() const;
+
+    bool IsDict() const;
+    Dict AsDict() const;
+
+    // копия в обычное дерево json::Node
+    json::Node ToNode() const;
+
+private:
+    enum class Type : uint8_t {
+        NULL_VALUE,
+        ARRAY,
+        DICT,
+        BOOL,
+        INT,
+        DOUBLE,
+        STRING,
+    };
+
+    Type type_ = Type::NULL_VALUE;
+    uint32_t size_ = 0; //длина строки или число элементов
+    union {
+        bool bool_;
+        int int_;
+        double double_ = 0.;
+        const char* string_;
+        const Node* array_;
+        const Member* dict_;
+    };
+};
+
+struct Member {
+    std::string_view first;
+    Node second;
+};
+
+class Document {
+public:
+    Document(detail::Arena arena, Node root);
+
+    const Node& GetRoot() const;
+    const detail::Arena& GetArena() const;
+
+private:
+    detail::Arena arena_;
+    Node root_;
+};
+
+// Разбирает документ так же, как json::Load(std::string_view), но в арену:
+// ни строки, ни узлы не выделяются по одному. Input после разбора не нужен
+Document Load(std::string_view input);
+
+}  //namespace arena
+
 }  //namespace json
\ No newline at end of file
@@ -1,9 +1,47 @@
 #include "json_builder.h"
 
+#include <charconv>
+#include <iterator>
+
 using namespace std::string_literals;
+using namespace std::string_view_literals;
 
 namespace json {
 
+namespace {
+
+void AppendQuoted(std::string& out, std::string_view value) {
+    out.push_back('"');
+    for (const char c : value) {
+        switch (c) {
+        case '\r':
+            out += "\\r"sv;
+            break;
+        case '\n':
+            out += "\\n"sv;
+            break;
+        case '"':
+            [[fallthrough]];
+        case '\\':
+            out.push_back('\\');
+            [[fallthrough]];
+        default:
+            out.push_back(c);
+            break;
+        }
+    }
+    out.push_back('"');
+}
+
+} //namespace
+
+std::string QuoteString(std::string_view value) {
+    std::string result;
+    result.reserve(value.size() + value.size() / 8 + 2);
+    AppendQuoted(result, value);
+    return result;
+}
+
 Context::Context(Builder& builder)
     :builder_(builder) {
 }
@@ -192,4 +230,296 @@ Node Builder::Build() {
     return root_;
 }
 
+Writer::Writer(std::ostream& output, size_t buffer_size, Layout layout)
+    : output_(output)
+    , buffer_size_(buffer_size)
+    , layout_(layout) {
+    buffer_.reserve(buffer_size_ + 1024);
+}
+
+Writer::~Writer() {
+    if (!finished_) {
+        try {
+            Flush();
+        }
+        catch (...) {
+        }
+    }
+}
+
+Writer::KeyContext Writer::Key(std::string_view key) {
+    if (frames_.empty() || !frames_.back().is_dict || frames_.back().has_key) {
+        throw std::logic_error("Attempt to create a Key outside a Dict");
+    }
+    Frame& frame = frames_.back();
+    if (!frame.is_empty) {
+        WriteSeparator();
+    }
+    frame.is_empty = false;
+    frame.has_key = true;
+    WriteIndent();
+    WriteString(key);
+    buffer_ += layout_ == Layout::PRETTY ? ": "sv : ":"sv;
+    return KeyContext(*this);
+}
+
+Writer::Context Writer::Value(std::nullptr_t) {
+    BeginValue();
+    buffer_ += "null"sv;
+    EndValue();
+    return Context(*this);
+}
+
+Writer::Context Writer::Value(bool value) {
+    BeginValue();
+    buffer_ += value ? "true"sv : "false"sv;
+    EndValue();
+    return Context(*this);
+}
+
+Writer::Context Writer::Value(int value) {
+    BeginValue();
+    char chars[16];
+    const auto result = std::to_chars(std::begin(chars), std::end(chars), value);
+    buffer_.append(chars, result.ptr);
+    EndValue();
+    return Context(*this);
+}
+
+Writer::Context Writer::Value(double value) {
+    BeginValue();
+    // как std::ostream << double с настройками по умолчанию, то есть printf("%.6g")
+    char chars[32];
+    const auto result = std::to_chars(std::begin(chars), std::end(chars), value, std::chars_format::general, 6);
+    buffer_.append(chars, result.ptr);
+    EndValue();
+    return Context(*this);
+}
+
+Writer::Context Writer::Value(std::string_view value) {
+    BeginValue();
+    WriteString(value);
+    EndValue();
+    return Context(*this);
+}
+
+Writer::Context Writer::Value(const std::string& value) {
+    return Value(std::string_view(value));
+}
+
+Writer::Context Writer::Value(const char* value) {
+    return Value(std::string_view(value));
+}
+
+Writer::Context Writer::Value(const Node& value) {
+    WriteNode(value);
+    return Context(*this);
+}
+
+Writer::Context Writer::Value(RawJson value) {
+    BeginValue();
+    buffer_ += value.text;
+    EndValue();
+    return Context(*this);
+}
+
+Writer::StartDictContext Writer::StartDict() {
+    BeginValue();
+    buffer_.push_back('{');
+    WriteNewLine();
+    frames_.push_back(Frame{ true });
+    return StartDictContext(*this);
+}
+
+Writer::StartArrayContext Writer::StartArray() {
+    BeginValue();
+    buffer_.push_back('[');
+    WriteNewLine();
+    frames_.push_back(Frame{ false });
+    return StartArrayContext(*this);
+}
+
+Writer::Context Writer::EndDict() {
+    CloseContainer(true);
+    return Context(*this);
+}
+
+Writer::Context Writer::EndArray() {
+    CloseContainer(false);
+    return Context(*this);
+}
+
+void Writer::Finish() {
+    if (!has_root_) {
+        throw std::logic_error("Attempt to build an empty json");
+    }
+    if (!frames_.empty()) {
+        throw std::logic_error("Attempt to build an incomplete json");
+    }
+    Flush();
+    finished_ = true;
+}
+
+void Writer::Flush() {
+    output_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    output_.flush();
+    buffer_.clear();
+}
+
+void Writer::BeginValue() {
+    if (frames_.empty()) {
+        if (has_root_) {
+            throw std::logic_error("Root already exists");
+        }
+        has_root_ = true;
+        return;
+    }
+    Frame& frame = frames_.back();
+    if (frame.is_dict) {
+        if (!frame.has_key) {
+            throw std::logic_error("Attempt to create value failed");
+        }
+        frame.has_key = false;
+        return;
+    }
+    if (!frame.is_empty) {
+        WriteSeparator();
+    }
+    frame.is_empty = false;
+    WriteIndent();
+}
+
+void Writer::EndValue() {
+    // отдаём текст только между значениями, чтобы не дробить запись мелкими порциями
+    if (buffer_.size() >= buffer_size_) {
+        Flush();
+    }
+}
+
+Writer::StartArrayContext Writer::StartArrayFragment() {
+    if (has_root_) {
+        throw std::logic_error("Array fragment must be the root");
+    }
+    has_root_ = true;
+    frames_.push_back(Frame{ false, true, false, true });
+    return StartArrayContext(*this);
+}
+
+void Writer::AppendArrayFragment(std::string_view fragment) {
+    // отступы фрагмента рассчитаны на элементы корневого массива
+    if (frames_.size() != 1 || frames_.back().is_dict) {
+        throw std::logic_error("Array fragment can be appended only to the root array");
+    }
+    if (fragment.empty()) {
+        return;
+    }
+    Frame& frame = frames_.back();
+    if (!frame.is_empty) {
+        WriteSeparator();
+    }
+    frame.is_empty = false;
+    buffer_ += fragment;
+    EndValue();
+}
+
+void Writer::CloseContainer(bool is_dict) {
+    if (frames_.empty() || frames_.back().is_dict != is_dict || frames_.back().has_key) {
+        throw std::logic_error(is_dict ? "Unexpected end of dictionary" : "Unexpected end of array");
+    }
+    if (frames_.back().is_fragment) {
+        frames_.pop_back();
+        EndValue();
+        return;
+    }
+    frames_.pop_back();
+    WriteNewLine();
+    WriteIndent();
+    buffer_.push_back(is_dict ? '}' : ']');
+    EndValue();
+}
+
+void Writer::WriteSeparator() {
+    buffer_.push_back(',');
+    WriteNewLine();
+}
+
+void Writer::WriteNewLine() {
+    if (layout_ == Layout::PRETTY) {
+        buffer_.push_back('\n');
+    }
+}
+
+void Writer::WriteIndent() {
+    if (layout_ == Layout::ONE_LINE) {
+        return;
+    }
+    const size_t INDENT_STEP = 4;
+    buffer_.append(frames_.size() * INDENT_STEP, ' ');
+}
+
+void Writer::WriteString(std::string_view value) {
+    AppendQuoted(buffer_, value);
+}
+
+void Writer::WriteNode(const Node& node) {
+    if (node.IsArray()) {
+        StartArray();
+        for (const Node& item : node.AsArray()) {
+            WriteNode(item);
+        }
+        EndArray();
+    }
+    else if (node.IsDict()) {
+        StartDict();
+        for (const auto& [key, item] : node.AsDict()) {
+            Key(key);
+            WriteNode(item);
+        }
+        EndDict();
+    }
+    else if (node.IsString()) {
+        Value(std::string_view(node.AsString()));
+    }
+    else if (node.IsBool()) {
+        Value(node.AsBool());
+    }
+    else if (node.IsInt()) {
+        Value(node.AsInt());
+    }
+    else if (node.IsPureDouble()) {
+        Value(node.AsDouble());
+    }
+    else {
+        Value(nullptr);
+    }
+}
+
+Writer::Context::Context(Writer& writer)
+    : writer_(writer) {
+}
+
+Writer::KeyContext Writer::Context::Key(std::string_view key) {
+    return writer_.Key(key);
+}
+
+Writer::StartDictContext Writer::Context::StartDict() {
+    return writer_.StartDict();
+}
+
+Writer::StartArrayContext Writer::Context::StartArray() {
+    return writer_.StartArray();
+}
+
+Writer::Context Writer::Context::EndDict() {
+    return writer_.EndDict();
+}
+
+Writer::Context Writer::Context::EndArray() {
+    return writer_.EndArray();
+}
+
+void Writer::Context::Finish() {
+    writer_.Finish();
+}
+
 } //namespace json
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include <memory>
 #include <iostream> 
 #include <string>
+#include <string_view>
+#include <vector>
 
 using namespace std::string_literals;
 
@@ -106,5 +108,195 @@ public:
     Node Build();
 };
 
+// Готовый текст JSON, который Writer вставляет как есть, например заранее экранированная строка.
+// Это должно быть одно значение без переводов строк, иначе собьются отступы
+struct RawJson {
+    std::string_view text;
+};
+
+// Строка в кавычках и с экранированием, как её выводят json::Print и Writer
+std::string QuoteString(std::string_view value);
+
+// Пишет JSON прямо в output по мере вызовов, не строя дерево, в том же виде, что и json::Print.
+// Текст копится в буфере и уходит в output порциями по buffer_size байт, поэтому первые ответы
+// выходят раньше, чем построены последние, а память не растёт с размером документа.
+// Контексты те же, что у Builder: недопустимые цепочки вызовов не компилируются
+class Writer {
+public:
+    class Context;
+    class KeyContext;
+    class ValueContext;
+    class StartDictContext;
+    class StartArrayContext;
+    class ValueArrayContext;
+
+    static const size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    // PRETTY - как json::Print, с переводами строк и отступами; ONE_LINE - без пробелов
+    // и переводов строк, для построчных протоколов
+    enum class Layout {
+        PRETTY,
+        ONE_LINE,
+    };
+
+    explicit Writer(std::ostream& output, size_t buffer_size = DEFAULT_BUFFER_SIZE, Layout layout = Layout::PRETTY);
+    // дописывает буфер в output, если Finish не был вызван
+    ~Writer();
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    KeyContext Key(std::string_view key);
+
+    Context Value(std::nullptr_t);
+    Context Value(bool value);
+    Context Value(int value);
+    Context Value(double value);
+    Context Value(std::string_view value);
+    Context Value(const std::string& value);
+    Context Value(const char* value);
+    Context Value(const Node& value);
+    Context Value(RawJson value);
+
+    StartDictContext StartDict();
+    StartArrayContext StartArray();
+    Context EndDict();
+    Context EndArray();
+
+    // Корневой массив без скобок: пишутся только элементы с их отступами и разделителями,
+    // закрывается обычным EndArray. Так части одного большого массива можно записать
+    // отдельными Writer (например, в разных потоках) и склеить через AppendArrayFragment
+    StartArrayContext StartArrayFragment();
+    // Дописывает в открытый корневой массив элементы, записанные после StartArrayFragment
+    void AppendArrayFragment(std::string_view fragment);
+
+    // проверяет, что документ закрыт, и сбрасывает буфер в output
+    void Finish();
+    void Flush();
+
+    class Context {
+    public:
+        explicit Context(Writer& writer);
+
+        KeyContext Key(std::string_view key);
+        template <typename T>
+        Context Value(const T& value);
+        StartDictContext StartDict();
+        StartArrayContext StartArray();
+        Context EndDict();
+        Context EndArray();
+        void Finish();
+
+    protected:
+        Writer& writer_;
+    };
+
+    class ValueContext : public Context {
+    public:
+        using Context::Context;
+
+        template <typename T>
+        Context Value(const T& value) = delete;
+        StartDictContext StartDict() = delete;
+        StartArrayContext StartArray() = delete;
+        Context EndArray() = delete;
+        void Finish() = delete;
+    };
+
+    class StartDictContext : public Context {
+    public:
+        using Context::Context;
+
+        template <typename T>
+        Context Value(const T& value) = delete;
+        StartDictContext StartDict() = delete;
+        StartArrayContext StartArray() = delete;
+        Context EndArray() = delete;
+        void Finish() = delete;
+    };
+
+    class ValueArrayContext : public Context {
+    public:
+        using Context::Context;
+
+        template <typename T>
+        ValueArrayContext Value(const T& value);
+        KeyContext Key(std::string_view key) = delete;
+        Context EndDict() = delete;
+        void Finish() = delete;
+    };
+
+    class StartArrayContext : public Context {
+    public:
+        using Context::Context;
+
+        template <typename T>
+        ValueArrayContext Value(const T& value);
+        KeyContext Key(std::string_view key) = delete;
+        Context EndDict() = delete;
+        void Finish() = delete;
+    };
+
+    class KeyContext : public Context {
+    public:
+        using Context::Context;
+
+        template <typename T>
+        ValueContext Value(const T& value);
+        KeyContext Key(std::string_view key) = delete;
+        Context EndDict() = delete;
+        Context EndArray() = delete;
+        void Finish() = delete;
+    };
+
+private:
+    struct Frame {
+        bool is_dict = false;
+        bool is_empty = true;
+        bool has_key = false;
+        bool is_fragment = false;
+    };
+
+    std::ostream& output_;
+    size_t buffer_size_;
+    Layout layout_;
+    std::string buffer_;
+    std::vector<Frame> frames_;
+    bool has_root_ = false;
+    bool finished_ = false;
+
+    // разделитель и отступ перед очередным значением
+    void BeginValue();
+    void EndValue();
+    void CloseContainer(bool is_dict);
+    void WriteSeparator();
+    void WriteNewLine();
+    void WriteIndent();
+    void WriteString(std::string_view value);
+    void WriteNode(const Node& node);
+};
+
+template <typename T>
+Writer::Context Writer::Context::Value(const T& value) {
+    return writer_.Value(value);
+}
+
+template <typename T>
+Writer::ValueArrayContext Writer::ValueArrayContext::Value(const T& value) {
+    writer_.Value(value);
+    return ValueArrayContext(writer_);
+}
+
+template <typename T>
+Writer::ValueArrayContext Writer::StartArrayContext::Value(const T& value) {
+    writer_.Value(value);
+    return ValueArrayContext(writer_);
+}
+
+template <typename T>
+Writer::ValueContext Writer::KeyContext::Value(const T& value) {
+    writer_.Value(value);
+    return ValueContext(writer_);
+}
 
 } //namespace json
\ No newline at end of file
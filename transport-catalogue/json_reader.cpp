@@ -9,9 +9,35 @@ JSONReader::JSONReader(tr_cat::TransportCatalogue& transport_catalogue)
     , rh_(transport_catalogue_) {
 }
 
+namespace {
+
+// Запросы читаются в арену (json::arena), а всё, кроме stat_requests, копируется в обычный документ:
+// настройки и base_requests разбирают те же функции, что и при make_base
+json::arena::Document LoadRequests(std::istream& input) {
+    std::ostringstream text;
+    text << input.rdbuf();
+    return json::arena::Load(std::string_view(text.str()));
+}
+
+json::Document CopyWithoutStatRequests(const json::arena::Node& root) {
+    if (!root.IsDict()) {
+        return json::Document{ root.ToNode() };
+    }
+    json::Dict result;
+    for (const auto& [key, node] : root.AsDict()) {
+        if (key != "stat_requests"sv) {
+            result.emplace(std::string(key), node.ToNode());
+        }
+    }
+    return json::Document{ std::move(result) };
+}
+
+} //namespace
+
 //без сериализации
-json::Document JSONReader::ProcessJSON(std::istream& input) {
-    json::Document doc = json::Load(input);
+void JSONReader::ProcessJSON(std::istream& input, std::ostream& output) {
+    const json::arena::Document requests = LoadRequests(input);
+    json::Document doc = CopyWithoutStatRequests(requests.GetRoot());
     doc_ = &doc;
     CreateAndAddStops();
     AddDistances();
@@ -19,51 +45,338 @@ json::Document JSONReader::ProcessJSON(std::istream& input) {
     ReadRenderSettings();
     ReadRouterSettings();
     ReadSerializationSettings();
-    json::Document result = StatRequestsHandler();
-    return result;
+    StatRequestsHandler(requests.GetRoot(), output);
 }
 
-json::Document ProcessRequests(std::istream& input) {
+void ProcessRequests(std::istream& input, std::ostream& output, size_t threads) {
     tr_cat::TransportCatalogue tr_cat;
     JSONReader j_read(tr_cat);
-    json::Document result = j_read.ProcessRequests(input);
-    return result;
+    j_read.ProcessRequests(input, output, threads);
+}
+
+bool VerifyBase(std::istream& input, std::ostream& output) {
+    tr_cat::TransportCatalogue tr_cat;
+    JSONReader j_read(tr_cat);
+    return j_read.VerifyBase(input, output);
 }
 
-json::Document JSONReader::ProcessRequests(std::istream& input) {
+void ReportMemory(std::istream& input, std::ostream& output) {
+    tr_cat::TransportCatalogue tr_cat;
+    JSONReader j_read(tr_cat);
+    j_read.ReportMemory(input, output);
+}
+
+namespace {
+
+void PrintBusStat(std::ostream& output, const BusStat& stat) {
+    output << "route_length "sv << stat.route_length << ", geo_length "sv << stat.geo_length
+        << ", curvature "sv << stat.curvature << ", stop_count "sv << stat.stop_count
+        << ", unique_stop_count "sv << stat.unique_stop_count;
+}
+
+// пересчёт идёт тем же кодом, поэтому сравнение точное
+bool operator==(const BusStat& lhs, const BusStat& rhs) {
+    return lhs.route_length == rhs.route_length && lhs.geo_length == rhs.geo_length
+        && lhs.curvature == rhs.curvature && lhs.stop_count == rhs.stop_count
+        && lhs.unique_stop_count == rhs.unique_stop_count;
+}
+
+} //namespace
+
+void JSONReader::ProcessRequests(std::istream& input, std::ostream& output, size_t threads) {
    // LOG_DURATION("Process requests"s);
-    json::Document doc = json::Load(input);
+    const json::arena::Document requests = LoadRequests(input);
+    json::Document doc = CopyWithoutStatRequests(requests.GetRoot());
     doc_ = &doc;
     ReadSerializationSettings();
     FillBase();
-    json::Document result = StatRequestsHandler();
-    return result;
+    StatRequestsHandler(requests.GetRoot(), output, threads);
 }
 
-void JSONReader::MakeBase(std::istream& input) {
-    //LOG_DURATION("Make base"s);
-    json::Document doc = json::Load(input);
+namespace {
+
+// строки VmRSS, RssAnon и RssFile из /proc/self/status, если он есть
+void PrintResidentMemory(std::ostream& output) {
+    std::ifstream status("/proc/self/status");
+    bool found = false;
+    std::string line;
+    while (std::getline(status, line)) {
+        for (std::string_view key : { "VmRSS:"sv, "RssAnon:"sv, "RssFile:"sv }) {
+            if (line.compare(0, key.size(), key) == 0) {
+                output << line << '\n';
+                found = true;
+            }
+        }
+    }
+    if (!found) {
+        output << "Resident memory is unavailable\n"sv;
+    }
+}
+
+} //namespace
+
+void JSONReader::ReportMemory(std::istream& input, std::ostream& output) {
+    LoadBase(input);
+    const RoutingIndex::MemoryUsage usage = tr_router_->GetIndex()->GetMemoryUsage();
+    output << "Routing index: graph "sv << usage.graph << " bytes, router "sv << usage.router
+        << " bytes, edge metadata "sv << usage.edge_metadata << " bytes, timetable "sv << usage.timetable << " bytes\n"sv;
+    PrintResidentMemory(output);
+}
+
+void JSONReader::LoadBase(std::istream& input) {
+    const json::arena::Document requests = LoadRequests(input);
+    json::Document doc = CopyWithoutStatRequests(requests.GetRoot());
     doc_ = &doc;
-    CreateAndAddStops();
+    ReadSerializationSettings();
+    doc_ = nullptr;
+    if (serialization_set_.file_name.empty()) {
+        throw ReadJSONError("serialization_settings with the base file are required");
+    }
+    FillBase();
+}
+
+bool JSONReader::VerifyBase(std::istream& input, std::ostream& output) {
+    const json::arena::Document requests = LoadRequests(input);
+    json::Document doc = CopyWithoutStatRequests(requests.GetRoot());
+    doc_ = &doc;
+    ReadSerializationSettings();
+    FillBase();
+    doc_ = nullptr;
+
+    bool verified = true;
+    if (map_from_base_) {
+        const std::string rendered = MapRenderer(settings_, rh_).DrawMap();
+        const std::string& stored = map_cache_.GetSvg();
+        if (rendered == stored) {
+            output << "Stored map matches the rendered one\n"sv;
+        }
+        else {
+            verified = false;
+            output << "Stored map differs from the rendered one: "sv << stored.size() << " bytes stored, "sv
+                << rendered.size() << " bytes rendered\n"sv;
+        }
+    }
+    else {
+        output << "Base has no stored map\n"sv;
+    }
+
+    if (!transport_catalogue_.HasStoredBusStats()) {
+        output << "Base has no stored bus stats\n"sv;
+        return verified;
+    }
+    const size_t bus_count = transport_catalogue_.CountBuses();
+    size_t mismatches = 0;
+    output.precision(17);
+    for (BusId id = 0; id < bus_count; ++id) {
+        BusStat computed;
+        try {
+            computed = transport_catalogue_.ComputeBusStat(id);
+        }
+        catch (const std::out_of_range&) {
+            continue; //на такой маршрут запрос Bus отвечает ошибкой, статистика не используется
+        }
+        const BusStat& stored = transport_catalogue_.GetBusStat(id);
+        if (!(stored == computed)) {
+            ++mismatches;
+            output << "Bus "sv << transport_catalogue_.GetBusName(id) << ":\n  stored:   "sv;
+            PrintBusStat(output, stored);
+            output << "\n  computed: "sv;
+            PrintBusStat(output, computed);
+            output << '\n';
+        }
+    }
+    output << bus_count << " buses checked, "sv << mismatches << " mismatches\n"sv;
+    return verified && mismatches == 0;
+}
+
+void JSONReader::MakeBase(std::istream& input, std::optional<size_t> build_threads) {
+    //LOG_DURATION("Make base"s);
+    ReadBase(input);
+    if (build_threads) {
+        r_set_.build_threads_ = *build_threads;
+    }
+    TransportRouter tr_router(transport_catalogue_, r_set_, schedules_);
+    SerializeBase(tr_router);
+}
+
+// Разбирает корневой словарь потоком: каждый элемент base_requests собирается в Node
+// и сразу уходит в справочник, остальные ключи (настройки) собираются в небольшой словарь
+class JSONReader::BaseStreamHandler : public json::Handler {
+public:
+    explicit BaseStreamHandler(JSONReader& reader)
+        : reader_(reader) {
+    }
+
+    void StartDict() override {
+        Open([](json::Handler& handler) { handler.StartDict(); });
+    }
+    void Key(std::string key) override {
+        if (depth_ == 1) {
+            // корневые ключи не доходят до NodeBuilder, поэтому повторы проверяются здесь
+            if (!root_keys_.insert(key).second) {
+                throw json::ParsingError("Duplicate key '"s + key + "' have been found");
+            }
+            key_ = std::move(key);
+            return;
+        }
+        builder_.Key(std::move(key));
+    }
+    void EndDict() override {
+        Close([](json::Handler& handler) { handler.EndDict(); });
+    }
+    void StartArray() override {
+        if (depth_ == 0) {
+            throw ReadJSONError("Unexpected format of base");
+        }
+        if (depth_ == 1 && key_ == "base_requests"s) {
+            in_base_requests_ = true;
+            ++depth_;
+            return;
+        }
+        Open([](json::Handler& handler) { handler.StartArray(); });
+    }
+    void EndArray() override {
+        if (in_base_requests_ && depth_ == 2) {
+            in_base_requests_ = false;
+            --depth_;
+            return;
+        }
+        Close([](json::Handler& handler) { handler.EndArray(); });
+    }
+    void Value(json::Node value) override {
+        if (depth_ == 0) {
+            throw ReadJSONError("Unexpected format of base");
+        }
+        builder_.Value(std::move(value));
+        Flush();
+    }
+
+    json::Dict ExtractSettings() {
+        return std::move(settings_);
+    }
+
+private:
+    JSONReader& reader_;
+    json::NodeBuilder builder_;
+    json::Dict settings_;
+    std::string key_;
+    std::unordered_set<std::string> root_keys_;
+    size_t depth_ = 0;
+    bool in_base_requests_ = false;
+
+    template <typename Event>
+    void Open(Event event) {
+        if (depth_++ == 0) {
+            return;
+        }
+        event(builder_);
+    }
+
+    template <typename Event>
+    void Close(Event event) {
+        if (--depth_ == 0) {
+            return;
+        }
+        event(builder_);
+        Flush();
+    }
+
+    void Flush() {
+        if (!builder_.IsComplete()) {
+            return;
+        }
+        if (in_base_requests_) {
+            reader_.AddBaseRequest(builder_.Extract());
+        }
+        else {
+            settings_[key_] = builder_.Extract();
+        }
+    }
+};
+
+//наполняет справочник и читает настройки без построения роутера и сериализации,
+//base_requests разбираются потоком по одному запросу
+void JSONReader::ReadBase(std::istream& input) {
+    BaseStreamHandler handler(*this);
+    json::Parse(input, handler);
     AddDistances();
-    CreateAndAddBuses();
+    for (const json::Node& request : postponed_buses_) {
+        AddBus(request.AsDict());
+    }
+    postponed_buses_.clear();
+    for (const json::Node& request : schedule_requests_) {
+        AddSchedule(request.AsDict());
+    }
+    schedule_requests_.clear();
+
+    json::Document doc(handler.ExtractSettings());
+    doc_ = &doc;
     ReadRenderSettings();
     ReadRouterSettings();
     ReadSerializationSettings();
-    TransportRouter tr_router(transport_catalogue_, r_set_, rh_);
-    SerializeBase(tr_router);
+    doc_ = nullptr;
+}
+
+void JSONReader::AddBaseRequest(json::Node request) {
+    if (!request.IsDict()) {
+        throw ReadJSONError("Unexpected format of request");
+    }
+    const json::Dict& request_map = request.AsDict();
+    if (!request_map.count("type"s)) {
+        return;
+    }
+    if (request_map.at("type"s) == "Stop"s) {
+        AddStop(request_map);
+    }
+    else if (request_map.at("type"s) == "Bus"s) {
+        if (AreStopsKnown(request_map)) {
+            AddBus(request_map);
+        }
+        else {
+            postponed_buses_.push_back(std::move(request));
+        }
+    }
+    else if (request_map.at("type"s) == "Schedule"s) {
+        schedule_requests_.push_back(std::move(request));
+    }
+}
+
+const RouterSettings& JSONReader::GetRouterSettings() const {
+    return r_set_;
+}
+
+const BusSchedules& JSONReader::GetBusSchedules() const {
+    return schedules_;
+}
+
+RequestHandler& JSONReader::GetRequestHandler() {
+    return rh_;
 }
 
 void JSONReader::FillBase() {
     std::filesystem::path in_file = serialization_set_.file_name;
-    std::ifstream in(in_file, std::ios::binary);
-    tr_router_ = serial::DeserializeTrCatalogue(in, transport_catalogue_, settings_, r_set_, rh_); //logic lost to time
+    std::string map_svg;
+    if (serialization_set_.format == serial::BaseFormat::MAPPED) {
+        tr_router_ = serial::DeserializeMappedTrCatalogue(in_file, transport_catalogue_, settings_, r_set_, map_svg);
+    }
+    else {
+        std::ifstream in(in_file, std::ios::binary);
+        tr_router_ = serial::DeserializeTrCatalogue(in, transport_catalogue_, settings_, r_set_, map_svg); //logic lost to time
+    }
+    map_from_base_ = !map_svg.empty();
+    if (map_from_base_) {
+        map_cache_.Set(std::move(map_svg));
+    }
 }
 
 void JSONReader::SerializeBase(const TransportRouter& tr_router) {
     std::filesystem::path out_file = serialization_set_.file_name;
     std::ofstream out(out_file, std::ios::binary);
-    serial::SerializeTrCatalogue(out, rh_, settings_, tr_router);
+    if (serialization_set_.format == serial::BaseFormat::MAPPED) {
+        serial::SerializeMappedTrCatalogue(out, rh_, settings_, tr_router, serialization_set_);
+        return;
+    }
+    serial::SerializeTrCatalogue(out, rh_, settings_, tr_router, serialization_set_);
 }
 
 void JSONReader::CreateAndAddStops() {
@@ -73,16 +386,9 @@ void JSONReader::CreateAndAddStops() {
     }
     for (const json::Node& request : doc_->GetRoot().AsDict().at(req_format).AsArray()) {
         if (request.IsDict()) {
-            json::Dict request_map = request.AsDict();
+            const json::Dict& request_map = request.AsDict();
             if (!request_map.empty() && request_map.count("type"s) && request_map.at("type"s) == "Stop"s) {
-                
-                if (!request_map.count("name"s) || !request_map.count("latitude"s) || !request_map.count("latitude"s)
-                    || !request_map.count("road_distances"s)) {
-                    throw ReadJSONError("Unexpected format of AddStop request");
-                }
-                Stop stop = domain::MakeStop(request_map.at("name"s).AsString(), request_map.at("latitude"s).AsDouble(), request_map.at("longitude"s).AsDouble());
-                Stop* stop_ptr = transport_catalogue_.AddStop(std::move(stop));
-                distances_to_process_[stop_ptr] = ParseDistances(request_map.at("road_distances"s).AsDict());
+                AddStop(request_map);
             }
         }
         else {
@@ -109,18 +415,77 @@ void JSONReader::CreateAndAddBuses() {
         return;
     }
     for (const json::Node& request : doc_->GetRoot().AsDict().at(req_format).AsArray()) {
-        json::Dict request_map = request.AsDict();
+        const json::Dict& request_map = request.AsDict();
         if (!request_map.empty() && request_map.count("type"s) && request_map.at("type"s).AsString() == "Bus"s) {
-            Bus bus;
-            if (!request_map.count("name"s) || !request_map.count("is_roundtrip"s) || !request_map.count("stops"s)) {
-                throw ReadJSONError("Unexpected format of AddBus request");
+            AddBus(request_map);
+        }
+    }
+}
+
+void JSONReader::AddStop(const json::Dict& request_map) {
+    if (!request_map.count("name"s) || !request_map.count("latitude"s) || !request_map.count("latitude"s)
+        || !request_map.count("road_distances"s)) {
+        throw ReadJSONError("Unexpected format of AddStop request");
+    }
+    Stop stop = domain::MakeStop(request_map.at("name"s).AsString(), request_map.at("latitude"s).AsDouble(), request_map.at("longitude"s).AsDouble());
+    Stop* stop_ptr = transport_catalogue_.AddStop(std::move(stop));
+    distances_to_process_[stop_ptr] = ParseDistances(request_map.at("road_distances"s).AsDict());
+}
+
+void JSONReader::AddBus(const json::Dict& request_map) {
+    Bus bus;
+    if (!request_map.count("name"s) || !request_map.count("is_roundtrip"s) || !request_map.count("stops"s)) {
+        throw ReadJSONError("Unexpected format of AddBus request");
+    }
+    bus.name = request_map.at("name"s).AsString();
+    bus.is_round = request_map.at("is_roundtrip"s).AsBool();
+    ProcessRoute(bus, request_map.at("stops"s));
+    transport_catalogue_.AddBus(std::move(bus));
+}
+
+// {"type": "Schedule", "bus": имя, "headway": минуты, "first_departure": минуты от полуночи,
+//  "last_departure": минуты от полуночи, "velocities": [км/ч по перегонам запроса Bus] (необязательно)}
+void JSONReader::AddSchedule(const json::Dict& request_map) {
+    if (!request_map.count("bus"s) || !request_map.count("headway"s) || !request_map.count("first_departure"s)
+        || !request_map.count("last_departure"s)) {
+        throw ReadJSONError("Unexpected format of Schedule request");
+    }
+    const std::optional<Bus*> bus = transport_catalogue_.FindBus(request_map.at("bus"s).AsString());
+    if (!bus) {
+        throw ReadJSONError("Schedule for unknown bus " + request_map.at("bus"s).AsString());
+    }
+    BusSchedule schedule;
+    schedule.headway = request_map.at("headway"s).AsDouble();
+    schedule.first_departure = request_map.at("first_departure"s).AsDouble();
+    schedule.last_departure = request_map.at("last_departure"s).AsDouble();
+    if (schedule.headway <= 0. || schedule.first_departure > schedule.last_departure) {
+        throw ReadJSONError("Schedule of bus " + (*bus)->name + " should have positive headway and first_departure <= last_departure");
+    }
+    if (request_map.count("velocities"s)) {
+        for (const json::Node& velocity : request_map.at("velocities"s).AsArray()) {
+            if (velocity.AsDouble() <= 0.) {
+                throw ReadJSONError("Schedule of bus " + (*bus)->name + " has non-positive velocity");
             }
-            bus.name = request_map.at("name"s).AsString();
-            bus.is_round = request_map.at("is_roundtrip"s).AsBool();
-            ProcessRoute(bus, request_map.at("stops"s));
-            transport_catalogue_.AddBus(std::move(bus));
+            schedule.velocities.push_back(velocity.AsDouble());
+        }
+        const size_t stop_count = (*bus)->is_round ? (*bus)->route.size() : (*bus)->half_route.size();
+        if (schedule.velocities.size() + 1 != stop_count) {
+            throw ReadJSONError("Schedule of bus " + (*bus)->name + " should have a velocity per segment of its route");
         }
     }
+    schedules_[(*bus)->id] = std::move(schedule);
+}
+
+bool JSONReader::AreStopsKnown(const json::Dict& request_map) const {
+    if (!request_map.count("stops"s) || !request_map.at("stops"s).IsArray()) {
+        return true;
+    }
+    for (const json::Node& stop_on_route : request_map.at("stops"s).AsArray()) {
+        if (!stop_on_route.IsString() || !transport_catalogue_.FindStop(stop_on_route.AsString())) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void JSONReader::ReadRenderSettings() {
@@ -161,6 +526,26 @@ void JSONReader::ReadRouterSettings() {
     std::map<std::string, json::Node> map_set = doc_->GetRoot().AsDict().at(settings_type).AsDict();
     r_set_.bus_velocity_ =  map_set.at("bus_velocity"s).AsDouble();
     r_set_.bus_wait_time_ = map_set.at("bus_wait_time"s).AsInt();
+    if (map_set.count("router_engine"s)) {
+        std::optional<graph::RouterEngine> engine = ParseRouterEngine(map_set.at("router_engine"s).AsString());
+        if (!engine) {
+            throw ReadJSONError("Unknown router engine " + map_set.at("router_engine"s).AsString());
+        }
+        r_set_.router_engine_ = engine.value();
+    }
+    if (map_set.count("graph_model"s)) {
+        std::optional<GraphModel> model = ParseGraphModel(map_set.at("graph_model"s).AsString());
+        if (!model) {
+            throw ReadJSONError("Unknown graph model " + map_set.at("graph_model"s).AsString());
+        }
+        r_set_.graph_model_ = model.value();
+    }
+    if (map_set.count("build_threads"s)) {
+        if (map_set.at("build_threads"s).AsInt() < 0) {
+            throw ReadJSONError("build_threads should be non-negative");
+        }
+        r_set_.build_threads_ = map_set.at("build_threads"s).AsInt();
+    }
 }
 
 void JSONReader::ReadSerializationSettings() {
@@ -170,119 +555,358 @@ void JSONReader::ReadSerializationSettings() {
     }
     std::map<std::string, json::Node> map_set = doc_->GetRoot().AsDict().at(settings_type).AsDict();
     serialization_set_.file_name = map_set.at("file"s).AsString();
+    //формат задаётся явно или расширением .mmap
+    if (map_set.count("format"s)) {
+        const std::string& format = map_set.at("format"s).AsString();
+        if (format == "protobuf"s) {
+            serialization_set_.format = serial::BaseFormat::PROTOBUF;
+        }
+        else if (format == "mapped"s) {
+            serialization_set_.format = serial::BaseFormat::MAPPED;
+        }
+        else {
+            throw ReadJSONError("Unknown serialization format");
+        }
+    }
+    else if (std::filesystem::path(serialization_set_.file_name).extension() == ".mmap"s) {
+        serialization_set_.format = serial::BaseFormat::MAPPED;
+    }
+    if (map_set.count("perfect_hash"s)) {
+        serialization_set_.perfect_hash = map_set.at("perfect_hash"s).AsBool();
+    }
+    if (map_set.count("store_map"s)) {
+        serialization_set_.store_map = map_set.at("store_map"s).AsBool();
+    }
 }
 
-json::Document JSONReader::StatRequestsHandler() {
+namespace {
+
+const size_t STAT_REQUESTS_CHUNK_SIZE = 256;
+const size_t MAX_PENDING_CHUNKS_PER_THREAD = 4;
+
+struct ChunkAnswers {
+    bool ready = false;
+    std::string text;
+    std::exception_ptr error;
+};
+
+// Отвечает на item_count запросов кусками в thread_count потоках. Куски раздаются по общему счётчику,
+// так что освободившийся поток сразу берёт следующий. Готовые куски дописываются в writer в исходном
+// порядке, а вперёд уходит не больше MAX_PENDING_CHUNKS_PER_THREAD кусков на поток, чтобы память
+// не росла с размером ответа. answer_chunk(first, last, chunk_writer) пишет ответы на [first, last)
+template <typename AnswerChunk>
+void AnswerInParallel(size_t item_count, size_t thread_count, json::Writer& writer, const AnswerChunk& answer_chunk) {
+    const size_t chunk_count = (item_count + STAT_REQUESTS_CHUNK_SIZE - 1) / STAT_REQUESTS_CHUNK_SIZE;
+    const size_t max_pending = thread_count * MAX_PENDING_CHUNKS_PER_THREAD;
+    std::vector<ChunkAnswers> chunks(chunk_count);
+    std::mutex mutex;
+    std::condition_variable chunk_answered;
+    std::condition_variable chunk_written;
+    size_t next_chunk = 0;
+    size_t written_chunks = 0;
+    bool stopped = false;
+
+    auto work = [&]() {
+        while (true) {
+            size_t chunk = 0;
+            {
+                std::unique_lock lock(mutex);
+                chunk_written.wait(lock, [&] {
+                    return stopped || next_chunk == chunk_count || next_chunk < written_chunks + max_pending;
+                });
+                if (stopped || next_chunk == chunk_count) {
+                    return;
+                }
+                chunk = next_chunk++;
+            }
+            ChunkAnswers answers;
+            answers.ready = true;
+            // при ошибке уже записанное уходит в ответ, как и при последовательной обработке
+            std::ostringstream text;
+            try {
+                json::Writer chunk_writer(text);
+                chunk_writer.StartArrayFragment();
+                answer_chunk(chunk * STAT_REQUESTS_CHUNK_SIZE, std::min(item_count, (chunk + 1) * STAT_REQUESTS_CHUNK_SIZE), chunk_writer);
+                chunk_writer.EndArray().Finish();
+            }
+            catch (...) {
+                answers.error = std::current_exception();
+            }
+            answers.text = text.str();
+            {
+                std::lock_guard lock(mutex);
+                chunks[chunk] = std::move(answers);
+            }
+            chunk_answered.notify_all();
+        }
+    };
 
-    json::Array reply{};
-    std::string req_format = "stat_requests"s;
-    if (!CheckReqFormat(req_format)) {
-        return json::Document{ reply };
+    std::vector<std::thread> threads;
+    auto stop_and_join = [&]() {
+        {
+            std::lock_guard lock(mutex);
+            stopped = true;
+        }
+        chunk_written.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        threads.clear();
+    };
+    try {
+        for (size_t i = 0; i < std::min(thread_count, chunk_count); ++i) {
+            threads.emplace_back(work);
+        }
+        for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            ChunkAnswers answers;
+            {
+                std::unique_lock lock(mutex);
+                chunk_answered.wait(lock, [&] { return chunks[chunk].ready; });
+                answers = std::move(chunks[chunk]);
+                ++written_chunks;
+            }
+            chunk_written.notify_all();
+            writer.AppendArrayFragment(answers.text);
+            if (answers.error) {
+                std::rethrow_exception(answers.error);
+            }
+        }
     }
+    catch (...) {
+        stop_and_join();
+        throw;
+    }
+    stop_and_join();
+}
 
-    for (const json::Node& request : doc_->GetRoot().AsDict().at(req_format).AsArray()) {
-        json::Dict request_map = request.AsDict();
+} //namespace
+
+// Ответы пишутся сразу в output; ключи идут по алфавиту, как их выводил json::Print для json::Dict
+void JSONReader::StatRequestsHandler(const json::arena::Node& root, std::ostream& output, size_t threads) {
+    json::Writer writer(output);
+    writer.StartArray();
+
+    const std::string_view req_format = "stat_requests"sv;
+    if (!root.IsDict() || !root.AsDict().count(req_format) || !root.AsDict().at(req_format).IsArray()) {
+        writer.EndArray().Finish();
+        return;
+    }
 
-        if (request_map.empty()) {
-            continue;
+    const json::arena::Array requests = root.AsDict().at(req_format).AsArray();
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    if (threads > 1 && requests.size() > STAT_REQUESTS_CHUNK_SIZE) {
+        AnswerInParallel(requests.size(), threads, writer, [this, &requests](size_t first, size_t last, json::Writer& chunk_writer) {
+            for (size_t i = first; i < last; ++i) {
+                AnswerStatRequest(chunk_writer, requests[i]);
+            }
+        });
+    }
+    else {
+        for (const json::arena::Node& request : requests) {
+            AnswerStatRequest(writer, request);
         }
-        if (!request_map.count("type"s) || !request_map.count("id"s)) {
-            throw ReadJSONError("Unexpected format of stat request");
+    }
+    writer.EndArray().Finish();
+}
+
+void JSONReader::AnswerStatRequest(json::Writer& writer, const json::arena::Node& request) {
+    const json::arena::Dict request_map = request.AsDict();
+
+    if (request_map.empty()) {
+        return;
+    }
+    if (!request_map.count("type"s) || !request_map.count("id"s)) {
+        throw ReadJSONError("Unexpected format of stat request");
+    }
+
+    if (request_map.at("type"s).AsString() == "Stop"s) {
+        const std::optional<tr_cat::TransportCatalogue::NameRange> bus_names = rh_.GetBusNamesByStop(request_map.at("name"s).AsString());
+        if (!bus_names) {
+            ErrorResult(writer, request_map.at("id"s).AsInt());
+            return;
         }
+        writer.StartDict().Key("buses"s);
+        BusNames(writer, *bus_names);
+        writer.Key("request_id"s).Value(request_map.at("id"s).AsInt())
+              .EndDict();
+    }
 
-        if (request_map.at("type"s).AsString() == "Stop"s) {
-            bool found = transport_catalogue_.FindStop(request_map.at("name").AsString()).has_value();
-            if (!found) {
-                reply.emplace_back(ErrorResult(request_map.at("id"s).AsInt()));
-                continue;
-            }
-            json::Array bus_names = BusNames(request_map);
-            reply.emplace_back(json::Builder{}.StartDict()
-                                                .Key("request_id"s).Value(request_map.at("id"s).AsInt())
-                                                .Key("buses"s).Value(bus_names)
-                                              .EndDict().Build().AsDict());                               
-        }
-
-        if (request_map.at("type"s).AsString() == "Bus"s) {
-            std::optional<BusStat> bus_info = rh_.GetBusStat(request_map.at("name").AsString());
-            if (!bus_info) {
-                reply.emplace_back(ErrorResult(request_map.at("id"s).AsInt()));
-                continue;
-            }
-            reply.emplace_back(json::Builder{}.StartDict()
-                                                .Key("request_id"s).Value(request_map.at("id"s).AsInt())
-                                                .Key("curvature"s).Value(bus_info.value().curvature)
-                                                .Key("route_length"s).Value(bus_info.value().route_length)
-                                                .Key("stop_count"s).Value(bus_info.value().stop_count)
-                                                .Key("unique_stop_count").Value(bus_info.value().unique_stop_count)
-                                              .EndDict().Build().AsDict());
-
-        }
-
-        if (request_map.at("type"s).AsString() == "Map"s) {
-            MapRenderer m_rend(settings_, rh_);
-            std::string map_s = m_rend.DrawMap();
-            reply.emplace_back(json::Builder{}.StartDict()
-                                                .Key("request_id"s).Value(request_map.at("id"s).AsInt())
-                                                .Key("map"s).Value(map_s)
-                                              .EndDict().Build().AsDict());
-        }
-
-        if (request_map.at("type"s).AsString() == "Route"s) {
-             
-            std::optional<std::vector<Item>> items = tr_router_->FindRoute(request_map.at("from"s).AsString(), request_map.at("to"s).AsString());
-            if (!items) {
-                reply.emplace_back(ErrorResult(request_map.at("id"s).AsInt()));
-                continue;
-            }
-            std::pair<json::Array, double> route_inf = RouteItems(items.value());
+    if (request_map.at("type"s).AsString() == "Bus"s) {
+        std::optional<BusStat> bus_info = rh_.GetBusStat(request_map.at("name").AsString());
+        if (!bus_info) {
+            ErrorResult(writer, request_map.at("id"s).AsInt());
+            return;
+        }
+        writer.StartDict()
+                .Key("curvature"s).Value(bus_info.value().curvature)
+                .Key("request_id"s).Value(request_map.at("id"s).AsInt())
+                .Key("route_length"s).Value(bus_info.value().route_length)
+                .Key("stop_count"s).Value(bus_info.value().stop_count)
+                .Key("unique_stop_count").Value(bus_info.value().unique_stop_count)
+              .EndDict();
+
+    }
 
-            reply.emplace_back(json::Builder{}.StartDict()
-                                                .Key("request_id"s).Value(request_map.at("id"s).AsInt())
-                                                .Key("total_time"s).Value(route_inf.second)
-                                                .Key("items"s).Value(route_inf.first)
-                                              .EndDict().Build().AsDict());
+    if (request_map.at("type"s).AsString() == "Map"s) {
+        writer.StartDict()
+                .Key("map"s).Value(json::RawJson{ map_cache_.GetJsonString() })
+                .Key("request_id"s).Value(request_map.at("id"s).AsInt())
+              .EndDict();
+    }
+
+    if (request_map.at("type"s).AsString() == "Route"s) {
+         
+        // с departure_time - по расписанию к этому времени (минуты от полуночи); отрицательное
+        // или бесконечное время отвечает ошибкой, как неизвестная остановка
+        std::optional<std::vector<Item>> items;
+        if (!request_map.count("departure_time"s)) {
+            items = tr_router_->FindRoute(request_map.at("from"s).AsString(), request_map.at("to"s).AsString());
+        }
+        else if (const double departure = request_map.at("departure_time"s).AsDouble();
+            std::isfinite(departure) && departure >= 0.) {
+            items = tr_router_->FindRoute(request_map.at("from"s).AsString(), request_map.at("to"s).AsString(), departure);
+        }
+        if (!items) {
+            ErrorResult(writer, request_map.at("id"s).AsInt());
+            return;
         }
+        writer.StartDict().Key("items"s);
+        const double total_time = RouteItems(writer, items.value());
+        writer.Key("request_id"s).Value(request_map.at("id"s).AsInt())
+              .Key("total_time"s).Value(total_time)
+              .EndDict();
+    }
+
+    if (request_map.at("type"s).AsString() == "RouteMatrix"s) {
+        RouteMatrixResult(writer, request_map);
+    }
 
+    if (request_map.at("type"s).AsString() == "Isochrone"s) {
+        IsochroneResult(writer, request_map);
     }
-    return json::Document{ reply };
 }
 
-json::Array JSONReader::BusNames(json::Dict& request_map) {
-    const std::set<Bus*> buses_for_stop = rh_.GetBusesByStop(request_map.at("name").AsString());
-    json::Array bus_names;
-    if (!buses_for_stop.empty()) {
-        bus_names.reserve(buses_for_stop.size());
-        for (const auto& bus : buses_for_stop) {
-            bus_names.push_back(bus->name);
+// {"type": "Isochrone", "from": остановка, "max_time": минуты, "render": true/false}: stops - остановки,
+// до которых не дольше max_time, по возрастанию времени; map - SVG для наложения на карту, только если "render": true
+void JSONReader::IsochroneResult(json::Writer& writer, const json::arena::Dict& request_map) {
+    if (!request_map.count("from"s) || !request_map.count("max_time"s)) {
+        throw ReadJSONError("Unexpected format of Isochrone request");
+    }
+    const double max_time = request_map.at("max_time"s).AsDouble();
+    const std::optional<std::vector<ReachedStop>> reached = max_time < 0. ? std::nullopt
+        : tr_router_->FindReachableStops(request_map.at("from"s).AsString(), max_time);
+    if (!reached) {
+        ErrorResult(writer, request_map.at("id"s).AsInt());
+        return;
+    }
+    writer.StartDict();
+    if (request_map.count("render"s) && request_map.at("render"s).AsBool()) {
+        std::vector<std::pair<const Stop*, double>> stops;
+        stops.reserve(reached->size());
+        for (const ReachedStop& stop : *reached) {
+            stops.push_back({ transport_catalogue_.GetStop(stop.id), stop.time });
         }
+        writer.Key("map"s).Value(MapRenderer(settings_, rh_).DrawIsochrone(stops, max_time));
+    }
+    writer.Key("request_id"s).Value(request_map.at("id"s).AsInt())
+          .Key("stops"s).StartArray();
+    for (const ReachedStop& stop : *reached) {
+        writer.StartDict()
+                .Key("stop_name"s).Value(transport_catalogue_.GetStopName(stop.id))
+                .Key("time"s).Value(stop.time)
+              .EndDict();
+    }
+    writer.EndArray()
+          .EndDict();
+}
 
-        std::sort(bus_names.begin(), bus_names.end(),
-            [](const json::Node& node_lhs, const json::Node& node_rhs)
-            { return node_lhs.AsString() < node_rhs.AsString(); });
+// {"type": "RouteMatrix", "from": [остановки], "to": [остановки], "items": true/false}: times[i][j] - время
+// маршрута from[i] -> to[j], null, если его нет; items[i][j] - его items, только если "items": true
+void JSONReader::RouteMatrixResult(json::Writer& writer, const json::arena::Dict& request_map) {
+    if (!request_map.count("from"s) || !request_map.count("to"s)) {
+        throw ReadJSONError("Unexpected format of RouteMatrix request");
     }
-    return bus_names;
+    auto stop_names = [](const json::arena::Array& nodes) {
+        std::vector<std::string_view> names;
+        names.reserve(nodes.size());
+        for (const json::arena::Node& node : nodes) {
+            names.push_back(node.AsString());
+        }
+        return names;
+    };
+    const std::vector<std::string_view> from = stop_names(request_map.at("from"s).AsArray());
+    const std::vector<std::string_view> to = stop_names(request_map.at("to"s).AsArray());
+    const bool with_items = request_map.count("items"s) && request_map.at("items"s).AsBool();
+    const RouteMatrix matrix = tr_router_->BuildRouteMatrix(from, to, with_items);
+
+    writer.StartDict();
+    if (with_items) {
+        writer.Key("items"s).StartArray();
+        for (size_t row = 0; row < from.size(); ++row) {
+            writer.StartArray();
+            for (size_t cell = row * to.size(); cell < (row + 1) * to.size(); ++cell) {
+                if (matrix.times[cell]) {
+                    RouteItems(writer, matrix.items[cell]);
+                }
+                else {
+                    writer.Value(nullptr);
+                }
+            }
+            writer.EndArray();
+        }
+        writer.EndArray();
+    }
+    writer.Key("request_id"s).Value(request_map.at("id"s).AsInt())
+          .Key("times"s).StartArray();
+    for (size_t row = 0; row < from.size(); ++row) {
+        writer.StartArray();
+        for (size_t cell = row * to.size(); cell < (row + 1) * to.size(); ++cell) {
+            if (matrix.times[cell]) {
+                writer.Value(*matrix.times[cell]);
+            }
+            else {
+                writer.Value(nullptr);
+            }
+        }
+        writer.EndArray();
+    }
+    writer.EndArray()
+          .EndDict();
+}
+
+void JSONReader::BusNames(json::Writer& writer, tr_cat::TransportCatalogue::NameRange bus_names) {
+    writer.StartArray();
+    for (std::string_view bus_name : bus_names) {
+        writer.Value(bus_name);
+    }
+    writer.EndArray();
 }
 
-std::pair<json::Array, double> JSONReader::RouteItems(std::vector<Item> items) {
-    json::Array items_json;
+double JSONReader::RouteItems(json::Writer& writer, const std::vector<Item>& items) {
     double total_time = 0.;
+    writer.StartArray();
     for (const Item& item : items) {
         total_time += item.time;
-        json::Dict reply_item;
-        reply_item["type"s] = item.type;
-        reply_item["time"s] = item.time;
-        if (item.type == "Wait"s) {
-            reply_item["stop_name"s] = std::string(item.name);
+        if (item.type == "Wait"sv) {
+            writer.StartDict()
+                    .Key("stop_name"s).Value(item.name)
+                    .Key("time"s).Value(item.time)
+                    .Key("type"s).Value(item.type)
+                  .EndDict();
         }
         else {
-            reply_item["bus"s] = std::string(item.name);
-            reply_item["span_count"s] = item.span_count;
+            writer.StartDict()
+                    .Key("bus"s).Value(item.name)
+                    .Key("span_count"s).Value(item.span_count)
+                    .Key("time"s).Value(item.time)
+                    .Key("type"s).Value(item.type)
+                  .EndDict();
         }
-
-        items_json.emplace_back(reply_item);
     }
-    return { std::move(items_json), total_time };
+    writer.EndArray();
+    return total_time;
 }
 
 std::map<std::string, int> JSONReader::ParseDistances(const json::Dict& distances) {
@@ -293,13 +917,12 @@ std::map<std::string, int> JSONReader::ParseDistances(const json::Dict& distance
     return result;
 }
 
-void JSONReader::ProcessRoute(Bus& bus, json::Node& node) {
+void JSONReader::ProcessRoute(Bus& bus, const json::Node& node) {
     for (const json::Node& stop_on_route : node.AsArray()) {
         std::optional<Stop*> st = transport_catalogue_.FindStop(stop_on_route.AsString());
         if (st.has_value()) {
             Stop* stop = st.value();
             bus.route.push_back(stop);
-            bus.unique_stops.insert(stop);
         }
     }
     if (!bus.is_round) {
@@ -352,10 +975,9 @@ bool JSONReader::CheckSettingsReqFormat(std::string& settings_type) {
     return true;
 }
 
-json::Dict JSONReader::ErrorResult(int id) {
-    return json::Builder{}.StartDict()
-                            .Key("request_id"s).Value(id)
-                            .Key("error_message"s).Value("not found"s)
-                            .EndDict()
-                          .Build().AsDict();
+void JSONReader::ErrorResult(json::Writer& writer, int id) {
+    writer.StartDict()
+            .Key("error_message"s).Value("not found"s)
+            .Key("request_id"s).Value(id)
+          .EndDict();
 }
\ No newline at end of file
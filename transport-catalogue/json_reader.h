@@ -13,35 +13,80 @@
 #include <map>
 #include <string>
 #include <fstream>
+#include <sstream>
 #include <vector>
+#include <unordered_set>
 #include <functional>
+#include <optional>
 #include <algorithm>
 #include <filesystem>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cmath>
 
 
 class JSONReader {
 public:
     JSONReader(tr_cat::TransportCatalogue& transport_catalogue);
 
-    void MakeBase(std::istream& input);
-    json::Document ProcessRequests(std::istream& input);
+    // build_threads из командной строки заменяет routing_settings.build_threads
+    void MakeBase(std::istream& input, std::optional<size_t> build_threads = std::nullopt);
+    void ReadBase(std::istream& input);
+    // Ответы на stat_requests пишутся в output по мере обработки. При threads > 1 запросы
+    // обрабатываются кусками параллельно, ответы идут в том же порядке и совпадают побайтно;
+    // 0 - по числу ядер
+    void ProcessRequests(std::istream& input, std::ostream& output, size_t threads = 1);
 
-    json::Document ProcessJSON(std::istream& input);
+    void ProcessJSON(std::istream& input, std::ostream& output);
+
+    // Загружает базу по serialization_settings из input (stat_requests не нужны) для ответов
+    // через AnswerStatRequest, как в режиме serve
+    void LoadBase(std::istream& input);
+    // Пишет ответ на один запрос; справочник и маршрутизатор только читаются, поэтому после
+    // загрузки базы можно вызывать из нескольких потоков с разными writer. На пустой запрос
+    // и запрос неизвестного типа ничего не пишет
+    void AnswerStatRequest(json::Writer& writer, const json::arena::Node& request);
+
+    // Загружает базу как process_requests и сверяет сохранённые карту и статистику маршрутов с пересчитанными.
+    // Расхождения пишутся в output, возвращает false, если они есть
+    bool VerifyBase(std::istream& input, std::ostream& output);
+
+    // Загружает базу как process_requests и пишет в output, сколько памяти занимает индекс
+    // маршрутизации и сколько процесс держит в RAM: своей (anonymous) и общей с другими процессами (file)
+    void ReportMemory(std::istream& input, std::ostream& output);
+
+    const RouterSettings& GetRouterSettings() const;
+    const BusSchedules& GetBusSchedules() const;
+    RequestHandler& GetRequestHandler();
 
 private:
+    class BaseStreamHandler;
 
     tr_cat::TransportCatalogue& transport_catalogue_;
     RequestHandler rh_;
     json::Document* doc_ = nullptr;
-    TransportRouter* tr_router_ = nullptr;
+    std::unique_ptr<TransportRouter> tr_router_;
     std::unordered_map<Stop*, std::map<std::string, int>> distances_to_process_;
+    std::vector<json::Node> postponed_buses_; //автобусы, пришедшие раньше своих остановок
+    std::vector<json::Node> schedule_requests_; //разбираются, когда известны все автобусы
+    BusSchedules schedules_;
     RenderSettings settings_;
     RouterSettings r_set_;
     serial::SerializationSettings serialization_set_;
+    MapCache map_cache_{ settings_, rh_ };
+    bool map_from_base_ = false;
 
     void CreateAndAddStops();
     void AddDistances();
     void CreateAndAddBuses();
+    void AddBaseRequest(json::Node request);
+    void AddStop(const json::Dict& request_map);
+    void AddBus(const json::Dict& request_map);
+    bool AreStopsKnown(const json::Dict& request_map) const;
+    void AddSchedule(const json::Dict& request_map);
     void ReadRenderSettings();
     void ReadRouterSettings();
     void ReadSerializationSettings();
@@ -49,18 +94,21 @@ private:
 
     void FillBase();
 
-    json::Document StatRequestsHandler();
+    void StatRequestsHandler(const json::arena::Node& root, std::ostream& output, size_t threads = 1);
 
     std::map<std::string, int> ParseDistances(const json::Dict& distances);
-    void ProcessRoute(Bus& bus, json::Node& node);
+    void ProcessRoute(Bus& bus, const json::Node& node);
     svg::Color ParseColor(const json::Node& node);
-    json::Array BusNames(json::Dict& request_map);
-    std::pair<json::Array, double> RouteItems(std::vector<Item> items);
+    void BusNames(json::Writer& writer, tr_cat::TransportCatalogue::NameRange bus_names);
+    // пишет items и возвращает их суммарное время
+    double RouteItems(json::Writer& writer, const std::vector<Item>& items);
+    void RouteMatrixResult(json::Writer& writer, const json::arena::Dict& request_map);
+    void IsochroneResult(json::Writer& writer, const json::arena::Dict& request_map);
 
     bool CheckReqFormat(std::string& req_type);
     bool CheckSettingsReqFormat(std::string& settings_type);
 
-    json::Dict ErrorResult(int id);
+    void ErrorResult(json::Writer& writer, int id);
 };
 
 class ReadJSONError : public std::runtime_error {
@@ -68,4 +116,8 @@ public:
     using runtime_error::runtime_error;
 };
 
-json::Document ProcessRequests(std::istream& input);
\ No newline at end of file
+void ProcessRequests(std::istream& input, std::ostream& output, size_t threads = 1);
+
+bool VerifyBase(std::istream& input, std::ostream& output);
+
+void ReportMemory(std::istream& input, std::ostream& output);
\ No newline at end of file
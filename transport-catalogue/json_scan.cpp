@@ -0,0 +1,161 @@
+#include "json_scan.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define JSON_SCAN_SSE2
+#endif
+
+#if defined(JSON_SCAN_SSE2) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define JSON_SCAN_AVX2
+#define JSON_SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace json::detail {
+
+namespace {
+
+// ' ' и '\t', '\n', '\v', '\f', '\r' (коды 9-13)
+bool IsWhitespace(char c) {
+    return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+}
+
+bool IsStringSpecial(char c) {
+    return c == '"' || c == '\\' || c == '\n' || c == '\r';
+}
+
+const char* SkipWhitespaceScalar(const char* begin, const char* end) {
+    while (begin != end && IsWhitespace(*begin)) {
+        ++begin;
+    }
+    return begin;
+}
+
+const char* FindStringSpecialScalar(const char* begin, const char* end) {
+    while (begin != end && !IsStringSpecial(*begin)) {
+        ++begin;
+    }
+    return begin;
+}
+
+#ifdef JSON_SCAN_SSE2
+
+__m128i WhitespaceMask128(__m128i chunk) {
+    const __m128i shifted = _mm_sub_epi8(chunk, _mm_set1_epi8('\t'));
+    const __m128i in_range = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('\r' - '\t')), shifted);
+    return _mm_or_si128(in_range, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')));
+}
+
+const char* SkipWhitespaceSse2(const char* begin, const char* end) {
+    while (end - begin >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(WhitespaceMask128(chunk))) & 0xFFFFu;
+        if (mask != 0) {
+            return begin + __builtin_ctz(mask);
+        }
+        begin += 16;
+    }
+    return SkipWhitespaceScalar(begin, end);
+}
+
+const char* FindStringSpecialSse2(const char* begin, const char* end) {
+    while (end - begin >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask != 0) {
+            return begin + __builtin_ctz(mask);
+        }
+        begin += 16;
+    }
+    return FindStringSpecialScalar(begin, end);
+}
+
+#endif
+
+#ifdef JSON_SCAN_AVX2
+
+JSON_SCAN_TARGET_AVX2
+const char* SkipWhitespaceAvx2(const char* begin, const char* end) {
+    while (end - begin >= 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        const __m256i shifted = _mm256_sub_epi8(chunk, _mm256_set1_epi8('\t'));
+        const __m256i in_range = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8('\r' - '\t')), shifted);
+        const __m256i whitespace = _mm256_or_si256(in_range, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')));
+        const unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(whitespace));
+        if (mask != 0) {
+            return begin + __builtin_ctz(mask);
+        }
+        begin += 32;
+    }
+    return SkipWhitespaceSse2(begin, end);
+}
+
+JSON_SCAN_TARGET_AVX2
+const char* FindStringSpecialAvx2(const char* begin, const char* end) {
+    while (end - begin >= 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        const __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))));
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(special));
+        if (mask != 0) {
+            return begin + __builtin_ctz(mask);
+        }
+        begin += 32;
+    }
+    return FindStringSpecialSse2(begin, end);
+}
+
+#endif
+
+using ScanFunction = const char* (*)(const char*, const char*);
+
+struct ScanKernels {
+    ScanFunction skip_whitespace = SkipWhitespaceScalar;
+    ScanFunction find_string_special = FindStringSpecialScalar;
+    const char* name = "scalar";
+};
+
+ScanKernels ChooseScanKernels() {
+#ifdef JSON_SCAN_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return { SkipWhitespaceAvx2, FindStringSpecialAvx2, "avx2" };
+    }
+#endif
+#ifdef JSON_SCAN_SSE2
+    return { SkipWhitespaceSse2, FindStringSpecialSse2, "sse2" };
+#else
+    return {};
+#endif
+}
+
+const ScanKernels& GetScanKernels() {
+    static const ScanKernels kernels = ChooseScanKernels();
+    return kernels;
+}
+
+} //namespace
+
+const char* SkipWhitespace(const char* begin, const char* end) {
+    // чаще всего пробелов нет совсем или это один пробел после ':' или ','
+    if (begin != end && !IsWhitespace(*begin)) {
+        return begin;
+    }
+    if (end - begin >= 2 && !IsWhitespace(begin[1])) {
+        return begin + 1;
+    }
+    return GetScanKernels().skip_whitespace(begin, end);
+}
+
+const char* FindStringSpecial(const char* begin, const char* end) {
+    return GetScanKernels().find_string_special(begin, end);
+}
+
+const char* GetScanKernelName() {
+    return GetScanKernels().name;
+}
+
+} //namespace json::detail
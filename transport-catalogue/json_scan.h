@@ -0,0 +1,17 @@
+#pragma once
+
+namespace json::detail {
+
+// Поиск по буферу [begin, end) для json::Load(std::string_view).
+// Ядра SSE2/AVX2 выбираются при запуске по возможностям процессора, иначе работает скалярный вариант
+
+// первый символ, не являющийся пробельным в смысле std::isspace, или end
+const char* SkipWhitespace(const char* begin, const char* end);
+
+// первый из символов '"', '\\', '\n', '\r' или end
+const char* FindStringSpecial(const char* begin, const char* end);
+
+// имя используемого набора инструкций: "avx2", "sse2" или "scalar"
+const char* GetScanKernelName();
+
+} //namespace json::detail
@@ -1,36 +1,154 @@
 #include "json_reader.h"
 #include "transport_catalogue.h"
+#include "benchmark.h"
+#include "server.h"
 //#include "log_duration.h"
+#include <charconv>
 #include <fstream>
 #include <iostream>
 #include <string_view>
 #include <filesystem>
+#include <optional>
+#include <vector>
 
 using namespace std::literals;
 
 void PrintUsage(std::ostream& stream = std::cerr) {
-    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+    stream << "Usage: transport_catalogue [make_base [--threads=N]|process_requests [--threads=N]|verify_base|memory_report|serve --config=FILE [--socket=PATH] [--reply-cache=N]|benchmark_router [engine...]|benchmark_timetable|benchmark_json]\n"sv
+        << "serve --socket serves up to "sv << server::Server::MAX_CLIENTS << " clients at once and refuses the rest\n"sv;
+}
+
+// значение аргумента вида --name=value или nullopt, если имя другое
+std::optional<std::string_view> ParseOption(std::string_view arg, std::string_view name) {
+    if (arg.size() <= name.size() + 2 || arg.substr(0, 2) != "--"sv || arg.substr(2, name.size()) != name
+        || arg[name.size() + 2] != '=') {
+        return std::nullopt;
+    }
+    return arg.substr(name.size() + 3);
+}
+
+// неотрицательное число без знака и пробелов или nullopt, в том числе если оно не помещается в size_t
+std::optional<size_t> ParseCount(std::string_view text) {
+    size_t value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || error != std::errc() || end != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+// --threads=N из argv[2], если он есть. Nullopt вместе с ok = false - неверный аргумент
+std::optional<size_t> ParseThreads(int argc, char* argv[], bool& ok) {
+    ok = true;
+    if (argc <= 2) {
+        return std::nullopt;
+    }
+    const std::optional<std::string_view> value = ParseOption(argv[2], "threads"sv);
+    const std::optional<size_t> threads = value ? ParseCount(*value) : std::nullopt;
+    if (argc != 3 || !threads) {
+        ok = false;
+        return std::nullopt;
+    }
+    return threads;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
+    if (argc < 2) {
         PrintUsage();
         return 1;
     }
 
     const std::string_view mode(argv[1]);
+    if (argc != 2 && mode != "benchmark_router"sv && mode != "make_base"sv && mode != "process_requests"sv
+        && mode != "serve"sv) {
+        PrintUsage();
+        return 1;
+    }
 
     if (mode == "make_base"sv) {
+        bool threads_ok = true;
+        const std::optional<size_t> build_threads = ParseThreads(argc, argv, threads_ok);
+        if (!threads_ok) {
+            PrintUsage();
+            return 1;
+        }
         tr_cat::TransportCatalogue transport_catalogue;
         JSONReader j_read(transport_catalogue);
-        j_read.MakeBase(std::cin);
+        j_read.MakeBase(std::cin, build_threads);
 
     }
     else if (mode == "process_requests"sv) {
+        bool threads_ok = true;
+        const std::optional<size_t> threads = ParseThreads(argc, argv, threads_ok);
+        if (!threads_ok) {
+            PrintUsage();
+            return 1;
+        }
+        ProcessRequests(std::cin, std::cout, threads.value_or(1));
 
-        json::Document to_print = ProcessRequests(std::cin);
-        json::Print(to_print, std::cout);
-
+    }
+    else if (mode == "serve"sv) {
+        std::optional<std::string_view> config;
+        std::optional<std::string_view> socket_path;
+        std::optional<size_t> reply_cache;
+        for (int i = 2; i < argc; ++i) {
+            if (std::optional<std::string_view> value = ParseOption(argv[i], "config"sv); value && !config) {
+                config = value;
+            }
+            else if (value = ParseOption(argv[i], "socket"sv); value && !socket_path) {
+                socket_path = value;
+            }
+            else if (value = ParseOption(argv[i], "reply-cache"sv); value && !reply_cache && ParseCount(*value)) {
+                reply_cache = ParseCount(*value);
+            }
+            else {
+                PrintUsage();
+                return 1;
+            }
+        }
+        if (!config) {
+            PrintUsage();
+            return 1;
+        }
+        const size_t reply_cache_size = reply_cache.value_or(server::Server::DEFAULT_REPLY_CACHE_SIZE);
+        // неверная конфигурация или ошибка сокета - сообщение вместо terminate
+        try {
+            server::Server server{ std::filesystem::path(*config), reply_cache_size };
+            if (socket_path) {
+                server.ServeSocket(std::filesystem::path(*socket_path));
+            }
+            else {
+                server.ServeStream(std::cin, std::cout);
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+    }
+    else if (mode == "memory_report"sv) {
+        ReportMemory(std::cin, std::cout);
+    }
+    else if (mode == "verify_base"sv) {
+        return VerifyBase(std::cin, std::cout) ? 0 : 1;
+    }
+    else if (mode == "benchmark_router"sv) {
+        std::vector<graph::RouterEngine> engines;
+        for (int i = 2; i < argc; ++i) {
+            std::optional<graph::RouterEngine> engine = ParseRouterEngine(argv[i]);
+            if (!engine) {
+                PrintUsage();
+                return 1;
+            }
+            engines.push_back(*engine);
+        }
+        bench::CompareRouterEngines(std::cin, std::cout, engines);
+    }
+    else if (mode == "benchmark_timetable"sv) {
+        bench::MeasureTimetable(std::cin, std::cout);
+    }
+    else if (mode == "benchmark_json"sv) {
+        bench::CompareJsonParsers(std::cin, std::cout);
     }
     else {
         PrintUsage();
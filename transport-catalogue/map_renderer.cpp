@@ -1,4 +1,5 @@
 #include "map_renderer.h"
+#include "json_builder.h"
 
 using namespace std::literals::string_literals;
 
@@ -14,7 +15,7 @@ svg::Point SphereProjector::operator()(geo::Coordinates coords) const {
     };
 }
 
-MapRenderer::MapRenderer(RenderSettings& settings, RequestHandler& rh)
+MapRenderer::MapRenderer(const RenderSettings& settings, const RequestHandler& rh)
     :settings_(settings)
     , rh_(rh) {
     buses_ = rh_.GetAllBusesWithRoutesAndSorted();
@@ -143,6 +144,28 @@ std::string MapRenderer::DrawMap() {
     return ss.str();
 }
 
+std::string MapRenderer::DrawIsochrone(const std::vector<std::pair<const Stop*, double>>& stops, double max_time) {
+    SphereProjector proj{
+        geo_coords_.begin(), geo_coords_.end(), settings_.width, settings_.height, settings_.padding
+    };
+    const size_t band_count = settings_.color_palette.size();
+    //дальние остановки рисуются первыми, ближние - поверх них
+    for (auto it = stops.rbegin(); it != stops.rend(); ++it) {
+        const auto& [stop_ptr, time] = *it;
+        svg::Circle c;
+        c.SetCenter(proj(stop_ptr->place)).SetRadius(settings_.stop_radius * 2);
+        if (band_count != 0) {
+            const double share = max_time > 0. ? time / max_time : 0.;
+            const size_t band = std::min(static_cast<size_t>(share * band_count), band_count - 1);
+            c.SetFillColor(settings_.color_palette[band]);
+        }
+        image_.Add(c);
+    }
+    std::ostringstream ss;
+    image_.Render(ss);
+    return ss.str();
+}
+
 std::vector<geo::Coordinates> MapRenderer::CollectCoordinates() {
     std::vector<geo::Coordinates> geo_coords;
     for (const auto& [name, bus_ptr] : buses_) {
@@ -151,4 +174,38 @@ std::vector<geo::Coordinates> MapRenderer::CollectCoordinates() {
         }
     }
     return geo_coords;
-}
\ No newline at end of file
+}
+
+MapCache::MapCache(const RenderSettings& settings, const RequestHandler& rh)
+    : settings_(settings)
+    , rh_(rh) {
+}
+
+void MapCache::Set(std::string svg) {
+    svg_ = std::move(svg);
+    json_string_ = json::QuoteString(svg_);
+    version_.store(rh_.GetCatalogueVersion(), std::memory_order_release);
+}
+
+const std::string& MapCache::GetSvg() const {
+    Update();
+    return svg_;
+}
+
+const std::string& MapCache::GetJsonString() const {
+    Update();
+    return json_string_;
+}
+
+void MapCache::Update() const {
+    const uint64_t version = rh_.GetCatalogueVersion();
+    if (version_.load(std::memory_order_acquire) == version) {
+        return;
+    }
+    std::lock_guard lock(mutex_);
+    if (version_.load(std::memory_order_relaxed) != version) {
+        svg_ = MapRenderer(settings_, rh_).DrawMap();
+        json_string_ = json::QuoteString(svg_);
+        version_.store(version, std::memory_order_release);
+    }
+}
@@ -7,6 +7,9 @@
 
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <cstdlib>
 #include <iostream>
 #include <optional>
@@ -119,7 +122,7 @@ private:
 
 class MapRenderer {
 public:
-    explicit MapRenderer(RenderSettings& settings, RequestHandler& rh);
+    explicit MapRenderer(const RenderSettings& settings, const RequestHandler& rh);
 
     void DrawBusRouteLines();
 
@@ -131,6 +134,11 @@ public:
 
     std::string DrawMap();
 
+    // Отдельный SVG того же размера и в той же проекции, что и карта, чтобы накладывать поверх неё:
+    // круги вокруг остановок из stops (остановка и время до неё не больше max_time). Цвет - из палитры
+    // по доле max_time, то есть по полосам времени
+    std::string DrawIsochrone(const std::vector<std::pair<const Stop*, double>>& stops, double max_time);
+
 private:
     const RenderSettings& settings_;
     const RequestHandler& rh_;
@@ -141,4 +149,32 @@ private:
     std::vector<geo::Coordinates> geo_coords_;
     std::vector<geo::Coordinates> CollectCoordinates();
 
-};
\ No newline at end of file
+};
+
+// Карта одна на весь справочник, поэтому рисуется один раз (или берётся из базы) и дальше отдаётся
+// готовой, в том числе уже экранированной для ответа JSON. После добавлений в справочник
+// меняется его версия, и карта перерисовывается при следующем запросе.
+// Get* можно вызывать из нескольких потоков, Set - нет
+class MapCache {
+public:
+    MapCache(const RenderSettings& settings, const RequestHandler& rh);
+
+    // карта, нарисованная для текущего состояния справочника, например при make_base
+    void Set(std::string svg);
+
+    const std::string& GetSvg() const;
+    // GetSvg() в кавычках и с экранированием
+    const std::string& GetJsonString() const;
+
+private:
+    static constexpr uint64_t NO_VERSION = UINT64_MAX;
+
+    const RenderSettings& settings_;
+    const RequestHandler& rh_;
+    mutable std::mutex mutex_;
+    mutable std::atomic<uint64_t> version_ = NO_VERSION;
+    mutable std::string svg_;
+    mutable std::string json_string_;
+
+    void Update() const;
+};
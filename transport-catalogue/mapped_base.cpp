@@ -0,0 +1,159 @@
+#include "mapped_base.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TRCAT_HAS_MMAP
+#endif
+
+using namespace std::string_literals;
+
+namespace serial {
+
+namespace {
+
+const char MAGIC[8] = { 'T', 'R', 'C', 'A', 'T', 'M', 'A', 'P' };
+const uint32_t VERSION = 1;
+const uint32_t REQUIRED_SECTION_COUNT = static_cast<uint32_t>(MappedSection::ROUTE_PREV_EDGES) + 1;
+// по нему определяется файл, записанный на машине с другим порядком байтов
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct Header {
+	char magic[8];
+	uint32_t version = VERSION;
+	uint32_t byte_order_mark = BYTE_ORDER_MARK;
+	uint32_t size_t_size = sizeof(size_t);
+	uint32_t section_count = static_cast<uint32_t>(MappedSection::COUNT);
+};
+
+struct SectionEntry {
+	uint64_t offset = 0;
+	uint64_t size = 0;
+};
+
+uint64_t AlignSectionOffset(uint64_t offset) {
+	return (offset + MAPPED_SECTION_ALIGNMENT - 1) / MAPPED_SECTION_ALIGNMENT * MAPPED_SECTION_ALIGNMENT;
+}
+
+} //namespace
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+#ifdef TRCAT_HAS_MMAP
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw MappedBaseError("Can't open "s + path.string());
+	}
+	struct stat file_stat {};
+	if (fstat(fd, &file_stat) != 0) {
+		close(fd);
+		throw MappedBaseError("Can't stat "s + path.string());
+	}
+	size_ = static_cast<size_t>(file_stat.st_size);
+	if (size_ != 0) {
+		void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			close(fd);
+			throw MappedBaseError("Can't map "s + path.string());
+		}
+		data_ = static_cast<const char*>(data);
+	}
+	close(fd);
+#else
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		throw MappedBaseError("Can't open "s + path.string());
+	}
+	buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	data_ = buffer_.data();
+	size_ = buffer_.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef TRCAT_HAS_MMAP
+	if (data_ != nullptr) {
+		munmap(const_cast<char*>(data_), size_);
+	}
+#endif
+}
+
+const char* MappedFile::GetData() const {
+	return data_;
+}
+
+size_t MappedFile::GetSize() const {
+	return size_;
+}
+
+void MappedBaseWriter::AddSection(MappedSection section, const void* data, size_t size) {
+	sections_.at(static_cast<size_t>(section)) = Section{ data, size };
+}
+
+void MappedBaseWriter::Write(std::ostream& out) const {
+	Header header;
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	std::vector<SectionEntry> entries(sections_.size());
+	uint64_t offset = sizeof(Header) + sizeof(SectionEntry) * entries.size();
+	for (size_t i = 0; i < sections_.size(); ++i) {
+		offset = AlignSectionOffset(offset);
+		entries[i] = SectionEntry{ offset, sections_[i].size };
+		offset += sections_[i].size;
+	}
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(entries.data()), sizeof(SectionEntry) * entries.size());
+	uint64_t written = sizeof(Header) + sizeof(SectionEntry) * entries.size();
+	const char padding[MAPPED_SECTION_ALIGNMENT] = {};
+	for (size_t i = 0; i < sections_.size(); ++i) {
+		out.write(padding, entries[i].offset - written);
+		out.write(static_cast<const char*>(sections_[i].data), sections_[i].size);
+		written = entries[i].offset + entries[i].size;
+	}
+}
+
+MappedBase::MappedBase(const std::filesystem::path& path)
+	: file_(std::make_shared<const MappedFile>(path)) {
+	const char* data = file_->GetData();
+	const size_t size = file_->GetSize();
+	Header header;
+	if (size < sizeof(Header)) {
+		throw MappedBaseError("Not a mapped base: "s + path.string());
+	}
+	std::memcpy(&header, data, sizeof(Header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+		throw MappedBaseError("Not a mapped base: "s + path.string());
+	}
+	if (header.version != VERSION || header.byte_order_mark != BYTE_ORDER_MARK || header.size_t_size != sizeof(size_t)
+		|| header.section_count < REQUIRED_SECTION_COUNT || header.section_count > static_cast<uint32_t>(MappedSection::COUNT)) {
+		throw MappedBaseError("Mapped base was written by an incompatible build: "s + path.string());
+	}
+	if (size < sizeof(Header) + sizeof(SectionEntry) * header.section_count) {
+		throw MappedBaseError("Truncated mapped base: "s + path.string());
+	}
+	sections_.reserve(header.section_count);
+	for (uint32_t i = 0; i < header.section_count; ++i) {
+		SectionEntry entry;
+		std::memcpy(&entry, data + sizeof(Header) + sizeof(SectionEntry) * i, sizeof(SectionEntry));
+		if (entry.offset > size || entry.size > size - entry.offset) {
+			throw MappedBaseError("Truncated mapped base: "s + path.string());
+		}
+		sections_.emplace_back(data + entry.offset, entry.size);
+	}
+	sections_.resize(static_cast<size_t>(MappedSection::COUNT));
+}
+
+std::string_view MappedBase::GetBytes(MappedSection section) const {
+	return sections_.at(static_cast<size_t>(section));
+}
+
+std::shared_ptr<const void> MappedBase::GetStorage() const {
+	return file_;
+}
+
+} //namespace serial
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace serial {
+
+// Бинарный формат базы для process_requests без разбора protobuf:
+// заголовок, таблица секций и сами секции, выровненные по MAPPED_SECTION_ALIGNMENT.
+// Секции графа и таблицы маршрутов используются прямо из отображённого в память файла
+enum class MappedSection : uint32_t {
+	SETTINGS,          //TransportBase в protobuf только с настройками (и contraction hierarchy)
+	STOPS,             //MappedStop[]
+	STOP_NAMES,        //char[]
+	BUSES,             //MappedBus[]
+	BUS_NAMES,         //char[]
+	BUS_STOPS,         //uint32_t[] id остановок всех маршрутов подряд
+	DISTANCES,         //MappedDistance[]
+	GRAPH_EDGES,       //graph::Edge<double>[]
+	INCIDENCE_OFFSETS, //size_t[vertex_count + 1]
+	INCIDENCE_EDGES,   //graph::EdgeId[]
+	ROUTE_WEIGHTS,     //double[vertex_count * vertex_count]
+	ROUTE_PREV_EDGES,  //uint32_t[vertex_count * vertex_count]
+	//секции ниже необязательны: в базах, записанных раньше, их нет, и они читаются пустыми
+	STOP_NAMES_HASH_DISPLACEMENTS, //uint32_t[], tr_cat::PerfectHash имён остановок
+	STOP_NAMES_HASH_SLOTS,         //uint32_t[]
+	BUS_NAMES_HASH_DISPLACEMENTS,  //uint32_t[], tr_cat::PerfectHash имён автобусов
+	BUS_NAMES_HASH_SLOTS,          //uint32_t[]
+	BUS_STATS,                     //MappedBusStat[] параллельно BUSES
+	EDGE_INFOS,                    //MappedEdgeInfo[] по EdgeId
+	TIMETABLE_PATTERNS,            //MappedTimetablePattern[], Timetable::Pattern
+	TIMETABLE_STOPS,               //uint32_t[] id остановок шаблонов подряд
+	TIMETABLE_OFFSETS,             //double[] параллельно TIMETABLE_STOPS
+	COUNT,
+};
+
+const size_t MAPPED_SECTION_ALIGNMENT = 64;
+
+struct MappedStop {
+	uint64_t name_offset = 0;
+	uint64_t name_size = 0;
+	double lat = 0.;
+	double lng = 0.;
+};
+
+struct MappedBus {
+	uint64_t name_offset = 0;
+	uint64_t name_size = 0;
+	uint64_t first_stop = 0;
+	uint32_t stop_count = 0;
+	uint32_t half_route_size = 0;
+	uint32_t is_round = 0;
+	uint32_t reserved = 0;
+};
+
+struct MappedBusStat {
+	double geo_length = 0.;
+	double curvature = 0.;
+	int32_t route_length = 0;
+	uint32_t stop_count = 0;
+	uint32_t unique_stop_count = 0;
+	uint32_t reserved = 0;
+};
+
+struct MappedEdgeInfo {
+	uint32_t id = 0; //id остановки для Wait, автобуса для Bus
+	uint32_t span_count = 0;
+	uint32_t kind = 0; //EdgeKind
+	uint32_t reserved = 0;
+};
+
+struct MappedTimetablePattern {
+	uint32_t bus_id = 0;
+	uint32_t first_stop = 0;
+	uint32_t stop_count = 0;
+	uint32_t reserved = 0;
+	double headway = 0.;
+	double first_departure = 0.;
+	double last_departure = 0.;
+};
+
+struct MappedDistance {
+	uint32_t first_stop_id = 0;
+	uint32_t second_stop_id = 0;
+	int32_t distance = 0;
+	uint32_t reserved = 0;
+};
+
+class MappedBaseError : public std::runtime_error {
+public:
+	using runtime_error::runtime_error;
+};
+
+template <typename T>
+struct MappedArray {
+	const T* data = nullptr;
+	size_t size = 0;
+
+	const T& operator[](size_t index) const {
+		return data[index];
+	}
+	const T* begin() const {
+		return data;
+	}
+	const T* end() const {
+		return data + size;
+	}
+};
+
+// Файл только для чтения: mmap там, где он есть, иначе содержимое читается в память
+class MappedFile {
+public:
+	explicit MappedFile(const std::filesystem::path& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* GetData() const;
+	size_t GetSize() const;
+
+private:
+	const char* data_ = nullptr;
+	size_t size_ = 0;
+	std::vector<char> buffer_;
+};
+
+class MappedBaseWriter {
+public:
+	// данные не копируются и должны жить до вызова Write
+	void AddSection(MappedSection section, const void* data, size_t size);
+
+	template <typename T>
+	void AddSection(MappedSection section, const std::vector<T>& items) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		AddSection(section, items.data(), items.size() * sizeof(T));
+	}
+
+	void Write(std::ostream& out) const;
+
+private:
+	struct Section {
+		const void* data = nullptr;
+		size_t size = 0;
+	};
+	std::vector<Section> sections_ = std::vector<Section>(static_cast<size_t>(MappedSection::COUNT));
+};
+
+class MappedBase {
+public:
+	explicit MappedBase(const std::filesystem::path& path);
+
+	std::string_view GetBytes(MappedSection section) const;
+
+	template <typename T>
+	MappedArray<T> GetArray(MappedSection section) const {
+		static_assert(std::is_trivially_copyable_v<T>);
+		const std::string_view bytes = GetBytes(section);
+		if (bytes.size() % sizeof(T) != 0
+			|| reinterpret_cast<std::uintptr_t>(bytes.data()) % alignof(T) != 0) {
+			throw MappedBaseError("Malformed section of mapped base");
+		}
+		return MappedArray<T>{ reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T) };
+	}
+
+	// держит файл отображённым, пока жив хотя бы один владелец
+	std::shared_ptr<const void> GetStorage() const;
+
+private:
+	std::shared_ptr<const MappedFile> file_;
+	std::vector<std::string_view> sections_;
+};
+
+} //namespace serial
@@ -0,0 +1,204 @@
+#include "name_index.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace tr_cat {
+
+namespace {
+
+const uint64_t GOLDEN_RATIO = 0x9E3779B97F4A7C15ull;
+// среднее число имён в корзине и доля пустых слотов идеальной хеш-функции
+const size_t NAMES_PER_BUCKET = 4;
+const size_t SLOTS_PER_FOUR_NAMES = 5;
+const uint32_t MAX_DISPLACEMENT = 1u << 24;
+
+// финальное перемешивание splitmix64
+uint64_t Mix(uint64_t x) {
+	x ^= x >> 30;
+	x *= 0xBF58476D1CE4E5B9ull;
+	x ^= x >> 27;
+	x *= 0x94D049BB133111EBull;
+	x ^= x >> 31;
+	return x;
+}
+
+size_t GetBucket(uint64_t hash, size_t bucket_count) {
+	return Mix(hash) % bucket_count;
+}
+
+size_t GetSlot(uint64_t hash, uint32_t displacement, size_t slot_count) {
+	return Mix(hash + (displacement + 1ull) * GOLDEN_RATIO) % slot_count;
+}
+
+} //namespace
+
+uint64_t HashName(std::string_view name) {
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (const char c : name) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+PerfectHash BuildPerfectHash(const std::vector<std::string_view>& names) {
+	PerfectHash result;
+	if (names.empty()) {
+		return result;
+	}
+	const size_t bucket_count = (names.size() + NAMES_PER_BUCKET - 1) / NAMES_PER_BUCKET;
+	const size_t slot_count = names.size() * SLOTS_PER_FOUR_NAMES / 4 + 1;
+
+	std::vector<uint64_t> hashes(names.size());
+	std::vector<std::vector<uint32_t>> buckets(bucket_count);
+	for (uint32_t id = 0; id < names.size(); ++id) {
+		hashes[id] = HashName(names[id]);
+		buckets[GetBucket(hashes[id], bucket_count)].push_back(id);
+	}
+	// большие корзины размещаются первыми, пока свободных слотов много
+	std::vector<uint32_t> order(bucket_count);
+	for (uint32_t i = 0; i < bucket_count; ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t lhs, uint32_t rhs) {
+		return buckets[lhs].size() > buckets[rhs].size();
+	});
+
+	result.displacements.assign(bucket_count, 0);
+	result.slot_ids.assign(slot_count, NameIndex::NO_ID);
+	std::vector<size_t> slots;
+	for (uint32_t bucket : order) {
+		const std::vector<uint32_t>& ids = buckets[bucket];
+		if (ids.empty()) {
+			break;
+		}
+		uint32_t displacement = 0;
+		for (;; ++displacement) {
+			if (displacement == MAX_DISPLACEMENT) {
+				throw std::invalid_argument("Can't build a perfect hash: names repeat or collide");
+			}
+			slots.clear();
+			bool fits = true;
+			for (uint32_t id : ids) {
+				const size_t slot = GetSlot(hashes[id], displacement, slot_count);
+				if (result.slot_ids[slot] != NameIndex::NO_ID || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+					fits = false;
+					break;
+				}
+				slots.push_back(slot);
+			}
+			if (fits) {
+				break;
+			}
+		}
+		result.displacements[bucket] = displacement;
+		for (size_t i = 0; i < ids.size(); ++i) {
+			result.slot_ids[slots[i]] = ids[i];
+		}
+	}
+	return result;
+}
+
+NameIndex::NameIndex(const std::vector<std::string_view>& names)
+	: names_(names) {
+}
+
+void NameIndex::Add(uint32_t id) {
+	if (id != hashes_.size() || id >= names_.size()) {
+		throw std::logic_error("Names must be added to the index in id order");
+	}
+	hashes_.push_back(HashName(names_[id]));
+	perfect_hash_.reset();
+	if (table_ready_.load(std::memory_order_relaxed)) {
+		// заполненность не больше половины: в среднем полторы пробы на поиск
+		if (hashes_.size() * 2 > table_.size()) {
+			BuildTable();
+		}
+		else {
+			Insert(id);
+		}
+	}
+}
+
+std::optional<uint32_t> NameIndex::Find(std::string_view name) const {
+	const uint64_t hash = HashName(name);
+	if (perfect_hash_) {
+		return FindPerfect(name, hash);
+	}
+	if (!table_ready_.load(std::memory_order_acquire)) {
+		std::lock_guard lock(table_mutex_);
+		if (!table_ready_.load(std::memory_order_relaxed)) {
+			BuildTable();
+			table_ready_.store(true, std::memory_order_release);
+		}
+	}
+	const size_t mask = table_.size() - 1;
+	const uint32_t hash_tag = static_cast<uint32_t>(hash >> 32);
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		const Slot& slot = table_[i];
+		if (slot.id == NO_ID) {
+			return std::nullopt;
+		}
+		if (slot.hash_tag == hash_tag && names_[slot.id] == name) {
+			return slot.id;
+		}
+	}
+}
+
+void NameIndex::SetPerfectHash(PerfectHash perfect_hash) {
+	const size_t name_count = hashes_.size();
+	if ((name_count != 0 && (perfect_hash.displacements.empty() || perfect_hash.slot_ids.size() < name_count))) {
+		throw std::invalid_argument("Perfect hash does not match names");
+	}
+	perfect_hash_ = std::move(perfect_hash);
+	for (uint32_t id = 0; id < name_count; ++id) {
+		if (FindPerfect(names_[id], hashes_[id]) != id) {
+			perfect_hash_.reset();
+			throw std::invalid_argument("Perfect hash does not match names");
+		}
+	}
+	// открытая таблица больше не нужна
+	table_ready_.store(false, std::memory_order_relaxed);
+	std::vector<Slot>().swap(table_);
+}
+
+bool NameIndex::HasPerfectHash() const {
+	return perfect_hash_.has_value();
+}
+
+std::optional<uint32_t> NameIndex::FindPerfect(std::string_view name, uint64_t hash) const {
+	const std::vector<uint32_t>& displacements = perfect_hash_->displacements;
+	const std::vector<uint32_t>& slot_ids = perfect_hash_->slot_ids;
+	if (displacements.empty() || slot_ids.empty()) {
+		return std::nullopt;
+	}
+	const uint32_t displacement = displacements[GetBucket(hash, displacements.size())];
+	const uint32_t id = slot_ids[GetSlot(hash, displacement, slot_ids.size())];
+	if (id >= hashes_.size() || names_[id] != name) {
+		return std::nullopt;
+	}
+	return id;
+}
+
+void NameIndex::BuildTable() const {
+	size_t capacity = 16;
+	while (capacity < hashes_.size() * 2) {
+		capacity *= 2;
+	}
+	table_.assign(capacity, Slot{});
+	for (uint32_t id = 0; id < hashes_.size(); ++id) {
+		Insert(id);
+	}
+}
+
+void NameIndex::Insert(uint32_t id) const {
+	const size_t mask = table_.size() - 1;
+	size_t i = hashes_[id] & mask;
+	while (table_[i].id != NO_ID) {
+		i = (i + 1) & mask;
+	}
+	table_[i] = Slot{ static_cast<uint32_t>(hashes_[id] >> 32), id };
+}
+
+} //namespace tr_cat
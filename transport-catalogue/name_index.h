@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace tr_cat {
+
+// 64-битный FNV-1a: не зависит от платформы и сборки, поэтому годится для индекса, хранимого в базе
+uint64_t HashName(std::string_view name);
+
+// Идеальная хеш-функция набора имён (hash and displace): имя попадает в корзину,
+// смещение корзины выбирает слот, в слоте лежит id имени. Строится при make_base и хранится в базе
+struct PerfectHash {
+	std::vector<uint32_t> displacements; //по корзинам
+	std::vector<uint32_t> slot_ids;      //NO_ID в пустых слотах
+};
+
+// names[id] - имя с данным id; повторов быть не должно
+PerfectHash BuildPerfectHash(const std::vector<std::string_view>& names);
+
+// Индекс имя -> id поверх вектора имён каталога: хеши имён считаются один раз при добавлении,
+// поиск - открытая адресация с линейным пробированием по массиву {часть хеша, id},
+// строки сравниваются только при совпадении хеша. С идеальной хеш-функцией поиск - ровно одна проба.
+// Find можно вызывать из нескольких потоков, Add и SetPerfectHash - нет
+class NameIndex {
+public:
+	static constexpr uint32_t NO_ID = UINT32_MAX;
+
+	explicit NameIndex(const std::vector<std::string_view>& names);
+
+	// имя names[id] уже добавлено в вектор
+	void Add(uint32_t id);
+
+	std::optional<uint32_t> Find(std::string_view name) const;
+
+	// std::invalid_argument, если хеш-функция не отображает каждое имя в его id
+	void SetPerfectHash(PerfectHash perfect_hash);
+	bool HasPerfectHash() const;
+
+private:
+	struct Slot {
+		uint32_t hash_tag = 0;
+		uint32_t id = NO_ID;
+	};
+
+	const std::vector<std::string_view>& names_;
+	std::vector<uint64_t> hashes_;
+	std::optional<PerfectHash> perfect_hash_;
+
+	// таблица строится при первом поиске без идеальной хеш-функции, дальше пополняется в Add
+	mutable std::mutex table_mutex_;
+	mutable std::atomic<bool> table_ready_ = false;
+	mutable std::vector<Slot> table_;
+
+	std::optional<uint32_t> FindPerfect(std::string_view name, uint64_t hash) const;
+	void BuildTable() const;
+	void Insert(uint32_t id) const;
+};
+
+} //namespace tr_cat
@@ -0,0 +1,81 @@
+#include "reply_cache.h"
+
+#include <algorithm>
+#include <charconv>
+#include <functional>
+
+namespace server {
+
+ReplyCache::ReplyCache(size_t capacity)
+    : capacity_(capacity) {
+    // ёмкость делится между шардами поровну, остаток - по одному в первые
+    const size_t shard_count = std::min(capacity, MAX_SHARD_COUNT);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+        shards_.back()->capacity = capacity / shard_count + (i < capacity % shard_count ? 1 : 0);
+    }
+}
+
+bool ReplyCache::IsEnabled() const {
+    return !shards_.empty();
+}
+
+std::optional<std::string> ReplyCache::Get(std::string_view key, int id) {
+    if (!IsEnabled()) {
+        return std::nullopt;
+    }
+    Shard& shard = GetShard(key);
+    std::lock_guard lock(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        ++shard.misses;
+        return std::nullopt;
+    }
+    ++shard.hits;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    const CachedReply& reply = it->second->second;
+    char chars[16];
+    const auto result = std::to_chars(std::begin(chars), std::end(chars), id);
+    std::string text;
+    text.reserve(reply.prefix.size() + (result.ptr - chars) + reply.suffix.size());
+    text.append(reply.prefix).append(chars, result.ptr).append(reply.suffix);
+    return text;
+}
+
+void ReplyCache::Put(std::string key, CachedReply reply) {
+    if (!IsEnabled()) {
+        return;
+    }
+    Shard& shard = GetShard(key);
+    std::lock_guard lock(shard.mutex);
+    // другой поток мог успеть положить тот же ответ
+    if (shard.index.count(key)) {
+        return;
+    }
+    if (shard.entries.size() == shard.capacity) {
+        shard.index.erase(shard.entries.back().first);
+        shard.entries.pop_back();
+        ++shard.evictions;
+    }
+    shard.entries.emplace_front(std::move(key), std::move(reply));
+    shard.index.emplace(shard.entries.front().first, shard.entries.begin());
+}
+
+ReplyCache::Stats ReplyCache::GetStats() const {
+    Stats stats;
+    stats.capacity = capacity_;
+    for (const std::unique_ptr<Shard>& shard : shards_) {
+        std::lock_guard lock(shard->mutex);
+        stats.size += shard->entries.size();
+        stats.hits += shard->hits;
+        stats.misses += shard->misses;
+        stats.evictions += shard->evictions;
+    }
+    return stats;
+}
+
+ReplyCache::Shard& ReplyCache::GetShard(std::string_view key) {
+    return *shards_[std::hash<std::string_view>{}(key) % shards_.size()];
+}
+
+} //namespace server
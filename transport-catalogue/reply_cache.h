@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace server {
+
+// Готовый ответ без номера запроса: prefix + request_id + suffix
+struct CachedReply {
+    std::string prefix;
+    std::string suffix;
+};
+
+// Кэш готовых ответов на частые запросы с вытеснением давно не использованных (LRU).
+// Ключи разбиты по шардам со своими мьютексами, чтобы потоки клиентов не ждали друг друга.
+// Ёмкость - в ответах, 0 - кэш выключен
+class ReplyCache {
+public:
+    struct Stats {
+        size_t capacity = 0;
+        size_t size = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    explicit ReplyCache(size_t capacity);
+
+    ReplyCache(const ReplyCache&) = delete;
+    ReplyCache& operator=(const ReplyCache&) = delete;
+
+    bool IsEnabled() const;
+    // текст ответа с номером запроса id или nullopt, если ключа нет
+    std::optional<std::string> Get(std::string_view key, int id);
+    void Put(std::string key, CachedReply reply);
+
+    Stats GetStats() const;
+
+private:
+    static constexpr size_t MAX_SHARD_COUNT = 16;
+
+    struct Shard {
+        using Entries = std::list<std::pair<std::string, CachedReply>>;
+
+        std::mutex mutex;
+        size_t capacity = 0;
+        Entries entries; //от последнего использованного к давнему
+        std::unordered_map<std::string_view, Entries::iterator> index; //ключи ссылаются на строки в entries
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    size_t capacity_ = 0;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    Shard& GetShard(std::string_view key);
+};
+
+} //namespace server
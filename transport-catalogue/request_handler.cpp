@@ -6,67 +6,69 @@ RequestHandler::RequestHandler(const tr_cat::TransportCatalogue& db)
 std::optional<BusStat> RequestHandler::GetBusStat(const std::string_view& bus_name) const {
 	std::optional<Bus*> ref = db_.FindBus(bus_name);
 	if (ref) {
-		BusStat result;
-		double geo_l = 0.0;
-		std::vector<Stop*> route = ref.value()->route;
-		result.stop_count = route.size();
-		for (size_t i = 0; i + 1 < route.size(); ++i) {
-			geo::Coordinates from, to;
-			from = route[i]->place;
-			to = route[i + 1]->place;
-			geo_l += ComputeDistance(from, to);
-			result.route_length += db_.GetDistanceBtwStops(route[i], route[i + 1]);
-		}
-		result.curvature = result.route_length / geo_l;
-		result.unique_stop_count = ref.value()->unique_stops.size();
-		return result;
+		return db_.GetBusStat(ref.value()->id);
 	}
 	else {
 		return std::nullopt;
 	}
 }
 
-const std::set<Bus*> RequestHandler::GetBusesByStop(const std::string_view& stop_name) const {
+std::vector<Bus*> RequestHandler::GetBusesByStop(const std::string_view& stop_name) const {
+	std::vector<Bus*> result;
 	std::optional<Stop*> ref = db_.FindStop(stop_name);
 	if (ref) {
-		return db_.GetBusesForStop(ref.value());
+		for (BusId bus_id : db_.GetBusesForStop(ref.value()->id)) {
+			result.push_back(db_.GetBus(bus_id));
+		}
 	}
-	else {
-		std::set<Bus*> empty;
-		return empty;
+	return result;
+}
+
+std::optional<tr_cat::TransportCatalogue::NameRange> RequestHandler::GetBusNamesByStop(std::string_view stop_name) const {
+	std::optional<Stop*> ref = db_.FindStop(stop_name);
+	if (!ref) {
+		return std::nullopt;
 	}
+	return db_.GetBusNamesForStop(ref.value()->id);
 }
 
 const std::map<std::string_view, Bus*> RequestHandler::GetAllBusesWithRoutesAndSorted() const {
-	const std::map<std::string_view, Bus*>& sorted = db_.GetAllBuses();
 	std::map<std::string_view, Bus*> sorted_not_empty;
-	for (auto it = sorted.begin(); it != sorted.end(); ++it) {
-		if (!it->second->route.empty()) {
-			sorted_not_empty.insert(*it);
+	for (BusId bus_id : db_.GetSortedBusIds()) {
+		Bus* bus = db_.GetBus(bus_id);
+		if (!bus->route.empty()) {
+			sorted_not_empty.emplace_hint(sorted_not_empty.end(), bus->name, bus);
 		}
 	}
 	return sorted_not_empty;
 }
 
 const std::map<std::string_view, Stop*> RequestHandler::GetAllStopsWithBusesAndSorted() const {
-	const std::map<Stop*, std::set<Bus*>>& sorted = db_.GetStopsWithBuses();
 	std::map<std::string_view, Stop*> sorted_not_empty;
-	for (auto it = sorted.begin(); it != sorted.end(); ++it) {
-		if (!it->second.empty()) {
-			std::string_view name = it->first->name;
-			Stop* st = it->first;
-			sorted_not_empty.insert({ name, st });
+	for (StopId stop_id : db_.GetSortedStopIds()) {
+		const tr_cat::TransportCatalogue::BusIdRange buses = db_.GetBusesForStop(stop_id);
+		if (buses.begin() != buses.end()) {
+			Stop* stop = db_.GetStop(stop_id);
+			sorted_not_empty.emplace_hint(sorted_not_empty.end(), stop->name, stop);
 		}
 	}
 	return sorted_not_empty;
 }
 
-const std::map<std::string_view, Stop*>& RequestHandler::GetStopsIndex() const {
-	return db_.GetStopsIndex();
+std::vector<Stop*> RequestHandler::GetSortedStops() const {
+	std::vector<Stop*> result;
+	for (StopId stop_id : db_.GetSortedStopIds()) {
+		result.push_back(db_.GetStop(stop_id));
+	}
+	return result;
 }
 
-const std::map<std::string_view, Bus*> RequestHandler::GetAllBuses() const {
-	return db_.GetAllBuses();
+std::vector<Bus*> RequestHandler::GetSortedBuses() const {
+	std::vector<Bus*> result;
+	for (BusId bus_id : db_.GetSortedBusIds()) {
+		result.push_back(db_.GetBus(bus_id));
+	}
+	return result;
 }
 
 int RequestHandler::GetDistanceBtwStops(std::string_view first_name, std::string_view second_name) const {
@@ -83,6 +85,14 @@ int RequestHandler::GetDistanceBtwStops(std::string_view first_name, std::string
 	return db_.GetDistanceBtwStops(first_stop, second_stop);
 }
 
-const std::unordered_map<std::pair<Stop*, Stop*>, int, tr_cat::detail::PairPtrHasher>& RequestHandler::GetDistances() const {
+const std::vector<RoadDistance>& RequestHandler::GetDistances() const {
 	return db_.GetDistances();
+}
+
+uint64_t RequestHandler::GetCatalogueVersion() const {
+	return db_.GetVersion();
+}
+
+const std::vector<BusStat>& RequestHandler::GetBusStats() const {
+	return db_.GetBusStats();
 }
\ No newline at end of file
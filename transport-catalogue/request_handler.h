@@ -4,32 +4,43 @@
 #include "domain.h"
 #include "svg.h"
 
+#include <map>
 #include <unordered_set>
 #include <optional>
 #include <string>
+#include <vector>
 
 
 class RequestHandler {
 public:
     RequestHandler(const tr_cat::TransportCatalogue& db);
 
-    // Возвращает информацию о маршруте (запрос Bus)
+    // Возвращает информацию о маршруте (запрос Bus), посчитанную заранее
     std::optional<BusStat> GetBusStat(const std::string_view& bus_name) const;
 
-    // Возвращает маршруты, проходящие через
-    const std::set<Bus*> GetBusesByStop(const std::string_view& stop_name) const;
+    // Возвращает маршруты, проходящие через остановку, по возрастанию имён
+    std::vector<Bus*> GetBusesByStop(const std::string_view& stop_name) const;
+
+    // Имена тех же маршрутов без копирования (запрос Stop); nullopt, если остановки нет
+    std::optional<tr_cat::TransportCatalogue::NameRange> GetBusNamesByStop(std::string_view stop_name) const;
 
     const std::map<std::string_view, Bus*> GetAllBusesWithRoutesAndSorted() const;
 
     const std::map<std::string_view, Stop*> GetAllStopsWithBusesAndSorted() const;
 
-    const std::map<std::string_view, Stop*>& GetStopsIndex() const;
+    // все остановки и автобусы по возрастанию имён
+    std::vector<Stop*> GetSortedStops() const;
 
-    const std::map<std::string_view, Bus*> GetAllBuses() const;
+    std::vector<Bus*> GetSortedBuses() const;
 
     int GetDistanceBtwStops(std::string_view first_name, std::string_view second_name) const;
 
-    const std::unordered_map<std::pair<Stop*, Stop*>, int, tr_cat::detail::PairPtrHasher>& GetDistances() const;
+    const std::vector<RoadDistance>& GetDistances() const;
+
+    uint64_t GetCatalogueVersion() const;
+
+    // статистика всех маршрутов по id автобуса
+    const std::vector<BusStat>& GetBusStats() const;
 
 private:
 
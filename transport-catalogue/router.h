@@ -1,39 +1,213 @@
 #pragma once
 
 #include "graph.h"
+#include "contraction_hierarchy.h"
 
 #include <graph.pb.h>
 
 #include <algorithm>
 #include <cassert>
+#include <condition_variable>
 #include <cstdint>
 #include <iterator>
+#include <limits>
+#include <memory>
+#include <functional>
+#include <mutex>
 #include <optional>
+#include <queue>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace graph {
 
+namespace detail {
+
+// Reusable barrier for a fixed group of threads (std::barrier only appears in C++20)
+class Barrier {
+public:
+    explicit Barrier(size_t thread_count)
+        : thread_count_(thread_count) {
+    }
+
+    void ArriveAndWait() {
+        std::unique_lock lock(mutex_);
+        const size_t generation = generation_;
+        if (++arrived_ == thread_count_) {
+            arrived_ = 0;
+            ++generation_;
+            lock.unlock();
+            all_arrived_.notify_all();
+            return;
+        }
+        all_arrived_.wait(lock, [this, generation] { return generation != generation_; });
+    }
+
+private:
+    const size_t thread_count_;
+    size_t arrived_ = 0;
+    size_t generation_ = 0;
+    std::mutex mutex_;
+    std::condition_variable all_arrived_;
+};
+
+} //namespace detail
+
 template <typename Weight>
 struct RouteInternalData {
     Weight weight;
     std::optional<EdgeId> prev_edge;
 };
 
+// Row-major V*V table of the all-pairs engine in struct-of-arrays layout:
+// "no route" is a sentinel weight and previous edges are 32-bit ids, so a cell takes sizeof(Weight) + 4 bytes
 template <typename Weight>
-using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData<Weight>>>>;
+class RoutesInternalData {
+public:
+    using CompactEdgeId = std::uint32_t;
+
+    static constexpr Weight NO_ROUTE_WEIGHT = std::numeric_limits<Weight>::has_infinity
+        ? std::numeric_limits<Weight>::infinity() : std::numeric_limits<Weight>::max();
+    static constexpr CompactEdgeId NO_PREV_EDGE = std::numeric_limits<CompactEdgeId>::max();
+
+    RoutesInternalData() = default;
+    explicit RoutesInternalData(size_t vertex_count)
+        : vertex_count_(vertex_count)
+        , weights_(vertex_count * vertex_count, NO_ROUTE_WEIGHT)
+        , prev_edges_(vertex_count * vertex_count, NO_PREV_EDGE) {
+    }
+    RoutesInternalData(size_t vertex_count, std::vector<Weight> weights, std::vector<CompactEdgeId> prev_edges)
+        : vertex_count_(vertex_count)
+        , weights_(std::move(weights))
+        , prev_edges_(std::move(prev_edges)) {
+        if (weights_.size() != vertex_count * vertex_count || prev_edges_.size() != weights_.size()) {
+            throw std::invalid_argument("Routing table size doesn't match vertex count");
+        }
+    }
+    // Read-only view over a memory-mapped base, storage keeps the memory alive
+    RoutesInternalData(size_t vertex_count, const Weight* weights, const CompactEdgeId* prev_edges,
+        std::shared_ptr<const void> storage)
+        : vertex_count_(vertex_count)
+        , mapped_weights_(weights)
+        , mapped_prev_edges_(prev_edges)
+        , mapped_storage_(std::move(storage)) {
+    }
+
+    size_t GetVertexCount() const {
+        return vertex_count_;
+    }
+
+    // V*V row-major arrays
+    const Weight* GetWeights() const {
+        return mapped_weights_ ? mapped_weights_ : weights_.data();
+    }
+    const CompactEdgeId* GetPrevEdges() const {
+        return mapped_prev_edges_ ? mapped_prev_edges_ : prev_edges_.data();
+    }
+
+    std::optional<RouteInternalData<Weight>> GetRoute(VertexId from, VertexId to) const {
+        const size_t cell = from * vertex_count_ + to;
+        const Weight weight = GetWeights()[cell];
+        if (weight == NO_ROUTE_WEIGHT) {
+            return std::nullopt;
+        }
+        return RouteInternalData<Weight>{ weight, ToEdgeId(GetPrevEdges()[cell]) };
+    }
+
+    std::optional<EdgeId> GetPrevEdge(VertexId from, VertexId to) const {
+        return ToEdgeId(GetPrevEdges()[from * vertex_count_ + to]);
+    }
+
+    void SetRoute(VertexId from, VertexId to, Weight weight, std::optional<EdgeId> prev_edge) {
+        const size_t cell = from * vertex_count_ + to;
+        weights_[cell] = weight;
+        prev_edges_[cell] = prev_edge ? static_cast<CompactEdgeId>(*prev_edge) : NO_PREV_EDGE;
+    }
+
+    // Relaxes rows first_vertex_from, first_vertex_from + vertex_from_step, ... through vertex_through
+    void RelaxThroughVertex(VertexId vertex_through, VertexId first_vertex_from, size_t vertex_from_step) {
+        const Weight* through_weights = &weights_[vertex_through * vertex_count_];
+        const CompactEdgeId* through_prev_edges = &prev_edges_[vertex_through * vertex_count_];
+        for (VertexId vertex_from = first_vertex_from; vertex_from < vertex_count_; vertex_from += vertex_from_step) {
+            Weight* weights = &weights_[vertex_from * vertex_count_];
+            CompactEdgeId* prev_edges = &prev_edges_[vertex_from * vertex_count_];
+            const Weight weight_from = weights[vertex_through];
+            if (weight_from == NO_ROUTE_WEIGHT) {
+                continue;
+            }
+            const CompactEdgeId prev_edge_from = prev_edges[vertex_through];
+            for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+                if (through_weights[vertex_to] == NO_ROUTE_WEIGHT) {
+                    continue;
+                }
+                const Weight candidate_weight = weight_from + through_weights[vertex_to];
+                if (candidate_weight < weights[vertex_to]) {
+                    weights[vertex_to] = candidate_weight;
+                    prev_edges[vertex_to] = through_prev_edges[vertex_to] != NO_PREV_EDGE
+                        ? through_prev_edges[vertex_to] : prev_edge_from;
+                }
+            }
+        }
+    }
+
+    size_t GetMemoryUsage() const {
+        return sizeof(*this) + weights_.capacity() * sizeof(Weight) + prev_edges_.capacity() * sizeof(CompactEdgeId);
+    }
+
+    static size_t EstimateMemoryUsage(size_t vertex_count) {
+        return sizeof(RoutesInternalData) + vertex_count * vertex_count * (sizeof(Weight) + sizeof(CompactEdgeId));
+    }
+
+    // Size of the former vector<vector<optional<RouteInternalData>>> table, for comparison
+    static size_t EstimateNestedMemoryUsage(size_t vertex_count) {
+        return sizeof(std::vector<std::vector<std::optional<RouteInternalData<Weight>>>>)
+            + vertex_count * sizeof(std::vector<std::optional<RouteInternalData<Weight>>>)
+            + vertex_count * vertex_count * sizeof(std::optional<RouteInternalData<Weight>>);
+    }
+
+private:
+    static std::optional<EdgeId> ToEdgeId(CompactEdgeId edge_id) {
+        if (edge_id == NO_PREV_EDGE) {
+            return std::nullopt;
+        }
+        return edge_id;
+    }
+
+    size_t vertex_count_ = 0;
+    std::vector<Weight> weights_;
+    std::vector<CompactEdgeId> prev_edges_;
+    const Weight* mapped_weights_ = nullptr;
+    const CompactEdgeId* mapped_prev_edges_ = nullptr;
+    std::shared_ptr<const void> mapped_storage_;
+};
+
+// ALL_PAIRS precomputes every route once (O(V^3) time, V*V memory) and answers by table lookup,
+// DIJKSTRA keeps only the graph and runs a binary-heap search for every query,
+// CONTRACTION_HIERARCHY preprocesses shortcuts once and answers by a small bidirectional search
+enum class RouterEngine {
+    ALL_PAIRS,
+    DIJKSTRA,
+    CONTRACTION_HIERARCHY,
+};
 
 template <typename Weight>
 class Router {
 private:
     using Graph = DirectedWeightedGraph<Weight>;
 
+public:
+    // tc_serialize::Router layout: 0 - message per table cell, 1 - packed arrays
+    static constexpr uint32_t SERIALIZATION_VERSION = 1;
+
     
 public:
-    explicit Router(const Graph& graph);
+    // thread_count > 1 relaxes the rows of the all-pairs table concurrently, the table is the same as with one thread
+    explicit Router(const Graph& graph, RouterEngine engine = RouterEngine::ALL_PAIRS, size_t thread_count = 1);
     explicit Router(const Graph& graph, RoutesInternalData<Weight> routes_internal_data); //serialization purposes
+    explicit Router(const Graph& graph, ContractionHierarchy<Weight> hierarchy); //serialization purposes
 
     struct RouteInfo {
         Weight weight;
@@ -41,90 +215,141 @@ public:
     };
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Routes from one vertex to every vertex of targets, in the same order and the same as BuildRoute gives.
+    // DIJKSTRA runs one search until every target is settled, ALL_PAIRS reads a single row of the table,
+    // CONTRACTION_HIERARCHY answers target by target. Edges are collected only if with_edges
+    std::vector<std::optional<RouteInfo>> BuildRoutes(VertexId from, const std::vector<VertexId>& targets, bool with_edges) const;
+    // Weights of the routes from one vertex by vertex, nullopt for vertices farther than max_weight or unreachable.
+    // ALL_PAIRS scans a single row of the table, other engines run one Dijkstra search bounded by max_weight
+    std::vector<std::optional<Weight>> BuildReachableWeights(VertexId from, Weight max_weight) const;
+
+    RouterEngine GetEngine() const;
+
+    // Heap bytes of the precomputed data: the all-pairs table or the hierarchy
+    size_t GetMemoryUsage() const;
+
+    const RoutesInternalData<Weight>& GetRoutesInternalData() const;
 
     tc_serialize::Router SerializeRouter() const;
 
 private:
+    struct ShortestPathTree {
+        std::vector<std::optional<Weight>> weights;
+        std::vector<std::optional<EdgeId>> prev_edges;
+    };
+
+    std::optional<RouteInfo> BuildRouteAllPairs(VertexId from, VertexId to) const;
+    // walks the table's prev edges back from to; a corrupt table (a cycle or an edge that doesn't
+    // end at the current vertex) throws std::runtime_error instead of looping forever
+    std::vector<EdgeId> CollectAllPairsEdges(VertexId from, VertexId to, std::optional<EdgeId> last_edge) const;
+    std::optional<RouteInfo> BuildRouteDijkstra(VertexId from, VertexId to) const;
+    // settles vertices in order of weight until every target is settled, never going beyond max_weight
+    ShortestPathTree BuildShortestPathTree(VertexId from, const std::vector<VertexId>& targets,
+        std::optional<Weight> max_weight = std::nullopt) const;
+    std::vector<EdgeId> CollectTreeEdges(const ShortestPathTree& tree, VertexId to) const;
+    std::vector<VertexId> CollectRouteRecords(VertexId from, EdgeId last_edge,
+        const std::vector<std::optional<EdgeId>>& prev_edges) const;
+    bool IsPreferredOnTie(VertexId from, EdgeId candidate_edge, EdgeId current_edge,
+        const std::vector<std::optional<EdgeId>>& prev_edges) const;
     
     void InitializeRoutesInternalData(const Graph& graph) {
+        if (graph.GetEdgeCount() >= RoutesInternalData<Weight>::NO_PREV_EDGE) {
+            throw std::length_error("Too many edges for the all-pairs routing table");
+        }
         const size_t vertex_count = graph.GetVertexCount();
         for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData<Weight>{ ZERO_WEIGHT, std::nullopt };
+            routes_internal_data_.SetRoute(vertex, vertex, ZERO_WEIGHT, std::nullopt);
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
                 const auto& edge = graph.GetEdge(edge_id);
                 if (edge.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
+                const auto route_internal_data = routes_internal_data_.GetRoute(vertex, edge.to);
                 if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData<Weight>{ edge.weight, edge_id };
+                    routes_internal_data_.SetRoute(vertex, edge.to, edge.weight, edge_id);
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData<Weight>& route_from,
-        const RouteInternalData<Weight>& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = { candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge };
-        }
-    }
-
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                    }
-                }
+    // Relaxing through vertex_through never changes its own row and column,
+    // so every row depends only on itself and they can be relaxed by different threads
+    void RelaxRoutesInternalDataConcurrently(size_t vertex_count, size_t thread_count) {
+        detail::Barrier barrier(thread_count);
+        auto relax_rows = [this, vertex_count, thread_count, &barrier](VertexId first_vertex_from) {
+            for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
+                routes_internal_data_.RelaxThroughVertex(vertex_through, first_vertex_from, thread_count);
+                barrier.ArriveAndWait();
             }
+        };
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count - 1);
+        for (VertexId first_vertex_from = 1; first_vertex_from < thread_count; ++first_vertex_from) {
+            threads.emplace_back(relax_rows, first_vertex_from);
+        }
+        relax_rows(0);
+        for (std::thread& thread : threads) {
+            thread.join();
         }
     }
 
     static constexpr Weight ZERO_WEIGHT{};
     const Graph& graph_;
-    RoutesInternalData<Weight> routes_internal_data_; //std::vector<std::vector<std::optional<RouteInternalData>>>; 
+    RouterEngine engine_ = RouterEngine::ALL_PAIRS;
+    RoutesInternalData<Weight> routes_internal_data_;
+    std::optional<ContractionHierarchy<Weight>> hierarchy_;
 
 };
 
 template <typename Weight>
 tc_serialize::Router Router<Weight>::SerializeRouter() const {
     tc_serialize::Router router;
-    for (const std::vector<std::optional<RouteInternalData<Weight>>>& vec : routes_internal_data_) {
-        tc_serialize::VectorRouteInternalData* vector = router.add_routes_internal_data();
-        for (const std::optional<RouteInternalData<Weight>>& data : vec) {
-            tc_serialize::RouteInternalData* ser_data = vector->add_vector_route();
-            if (data) {
-                ser_data->set_has_v(true);
-                ser_data->set_weight(data.value().weight);
-                if (data.value().prev_edge) {
-                    ser_data->mutable_prev_edge()->set_prev_edge_id(data.value().prev_edge.value());
-                }
-            }
-            else {
-                ser_data->set_has_v(false);
-            }
-            
-        }
+    router.set_version(SERIALIZATION_VERSION);
+    const size_t vertex_count = routes_internal_data_.GetVertexCount();
+    const size_t cell_count = vertex_count * vertex_count;
+    tc_serialize::PackedRoutesInternalData* packed = router.mutable_packed_routes_internal_data();
+    packed->set_vertex_count(vertex_count);
+    packed->mutable_weights()->Reserve(cell_count);
+    packed->mutable_weights()->Add(routes_internal_data_.GetWeights(), routes_internal_data_.GetWeights() + cell_count);
+    packed->mutable_prev_edges()->Reserve(cell_count);
+    const auto* prev_edges = routes_internal_data_.GetPrevEdges();
+    for (size_t cell = 0; cell < cell_count; ++cell) {
+        packed->add_prev_edges(prev_edges[cell] == RoutesInternalData<Weight>::NO_PREV_EDGE
+            ? -1 : static_cast<int64_t>(prev_edges[cell]));
+    }
+    if (hierarchy_) {
+        *router.mutable_contraction_hierarchy() = hierarchy_->SerializeHierarchy();
     }
     return router;
 }
 
 template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+Router<Weight>::Router(const Graph& graph, RouterEngine engine, size_t thread_count)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-        std::vector<std::optional<RouteInternalData<Weight>>>(graph.GetVertexCount()))
+    , engine_(engine)
 {
+    if (engine_ == RouterEngine::CONTRACTION_HIERARCHY) {
+        hierarchy_.emplace(graph);
+        return;
+    }
+    if (engine_ == RouterEngine::DIJKSTRA) {
+        for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+        }
+        return;
+    }
+    routes_internal_data_ = RoutesInternalData<Weight>(graph.GetVertexCount());
     InitializeRoutesInternalData(graph);
 
     const size_t vertex_count = graph.GetVertexCount();
+    if (thread_count > 1 && vertex_count > 1) {
+        RelaxRoutesInternalDataConcurrently(vertex_count, std::min(thread_count, vertex_count));
+        return;
+    }
     for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+        routes_internal_data_.RelaxThroughVertex(vertex_through, 0, 1);
     }
 }
 
@@ -136,24 +361,260 @@ Router<Weight>::Router(const Graph& graph, RoutesInternalData<Weight> routes_int
 
 }
 
+template <typename Weight>
+Router<Weight>::Router(const Graph& graph, ContractionHierarchy<Weight> hierarchy)
+    : graph_(graph)
+    , engine_(RouterEngine::CONTRACTION_HIERARCHY)
+    , hierarchy_(std::move(hierarchy))
+{
+}
+
+template <typename Weight>
+RouterEngine Router<Weight>::GetEngine() const {
+    return engine_;
+}
+
+template <typename Weight>
+const RoutesInternalData<Weight>& Router<Weight>::GetRoutesInternalData() const {
+    return routes_internal_data_;
+}
+
+template <typename Weight>
+size_t Router<Weight>::GetMemoryUsage() const {
+    return routes_internal_data_.GetMemoryUsage() + (hierarchy_ ? hierarchy_->GetMemoryUsage() : 0);
+}
+
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
     VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
+    if (engine_ == RouterEngine::DIJKSTRA) {
+        return BuildRouteDijkstra(from, to);
+    }
+    if (engine_ == RouterEngine::CONTRACTION_HIERARCHY) {
+        auto route = hierarchy_->BuildRoute(from, to);
+        if (!route) {
+            return std::nullopt;
+        }
+        return RouteInfo{ route->weight, std::move(route->edges) };
+    }
+    return BuildRouteAllPairs(from, to);
+}
+
+template <typename Weight>
+std::vector<std::optional<typename Router<Weight>::RouteInfo>> Router<Weight>::BuildRoutes(VertexId from,
+    const std::vector<VertexId>& targets, bool with_edges) const {
+    std::vector<std::optional<RouteInfo>> routes(targets.size());
+    if (engine_ == RouterEngine::DIJKSTRA) {
+        const ShortestPathTree tree = BuildShortestPathTree(from, targets);
+        for (size_t i = 0; i < targets.size(); ++i) {
+            if (tree.weights[targets[i]]) {
+                routes[i] = RouteInfo{ *tree.weights[targets[i]],
+                    with_edges ? CollectTreeEdges(tree, targets[i]) : std::vector<EdgeId>{} };
+            }
+        }
+        return routes;
+    }
+    if (engine_ == RouterEngine::CONTRACTION_HIERARCHY) {
+        for (size_t i = 0; i < targets.size(); ++i) {
+            routes[i] = BuildRoute(from, targets[i]);
+        }
+        return routes;
+    }
+    const size_t vertex_count = routes_internal_data_.GetVertexCount();
+    if (from >= vertex_count) {
+        throw std::out_of_range("Vertex is out of the routing table");
+    }
+    // the row of from is contiguous in both arrays
+    const Weight* row_weights = routes_internal_data_.GetWeights() + from * vertex_count;
+    const auto* row_prev_edges = routes_internal_data_.GetPrevEdges() + from * vertex_count;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        if (targets[i] >= vertex_count) {
+            throw std::out_of_range("Vertex is out of the routing table");
+        }
+        const Weight weight = row_weights[targets[i]];
+        if (weight == RoutesInternalData<Weight>::NO_ROUTE_WEIGHT) {
+            continue;
+        }
+        routes[i] = RouteInfo{ weight, std::vector<EdgeId>{} };
+        if (with_edges && row_prev_edges[targets[i]] != RoutesInternalData<Weight>::NO_PREV_EDGE) {
+            routes[i]->edges = CollectAllPairsEdges(from, targets[i], row_prev_edges[targets[i]]);
+        }
+    }
+    return routes;
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> Router<Weight>::BuildReachableWeights(VertexId from, Weight max_weight) const {
+    if (engine_ != RouterEngine::ALL_PAIRS) {
+        return BuildShortestPathTree(from, {}, max_weight).weights;
+    }
+    const size_t vertex_count = routes_internal_data_.GetVertexCount();
+    if (from >= vertex_count) {
+        throw std::out_of_range("Vertex is out of the routing table");
+    }
+    const Weight* row_weights = routes_internal_data_.GetWeights() + from * vertex_count;
+    std::vector<std::optional<Weight>> weights(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        if (row_weights[vertex] != RoutesInternalData<Weight>::NO_ROUTE_WEIGHT && !(max_weight < row_weights[vertex])) {
+            weights[vertex] = row_weights[vertex];
+        }
+    }
+    return weights;
+}
+
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRouteAllPairs(VertexId from,
+    VertexId to) const {
+    if (from >= routes_internal_data_.GetVertexCount() || to >= routes_internal_data_.GetVertexCount()) {
+        throw std::out_of_range("Vertex is out of the routing table");
+    }
+    const auto route_internal_data = routes_internal_data_.GetRoute(from, to);
     if (!route_internal_data) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
+    return RouteInfo{ route_internal_data->weight, CollectAllPairsEdges(from, to, route_internal_data->prev_edge) };
+}
+
+template <typename Weight>
+std::vector<EdgeId> Router<Weight>::CollectAllPairsEdges(VertexId from, VertexId to, std::optional<EdgeId> last_edge) const {
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
+    // a shortest route visits every vertex at most once
+    const size_t max_edge_count = routes_internal_data_.GetVertexCount();
+    VertexId vertex = to;
+    for (std::optional<EdgeId> edge_id = last_edge;
         edge_id;
-        edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+        edge_id = routes_internal_data_.GetPrevEdge(from, vertex))
     {
+        const Edge<Weight>& edge = graph_.GetEdge(*edge_id);
+        if (edges.size() == max_edge_count || edge.to != vertex || edge.from >= max_edge_count) {
+            throw std::runtime_error("Routing table is corrupt");
+        }
         edges.push_back(*edge_id);
+        vertex = edge.from;
+    }
+    if (vertex != from) {
+        throw std::runtime_error("Routing table is corrupt");
     }
     std::reverse(edges.begin(), edges.end());
+    return edges;
+}
 
-    return RouteInfo{ weight, std::move(edges) };
+template <typename Weight>
+std::vector<VertexId> Router<Weight>::CollectRouteRecords(VertexId from, EdgeId last_edge,
+    const std::vector<std::optional<EdgeId>>& prev_edges) const {
+    std::vector<VertexId> records;
+    for (VertexId vertex = graph_.GetEdge(last_edge).from;
+        vertex != from;
+        vertex = graph_.GetEdge(*prev_edges[vertex]).from)
+    {
+        if (records.empty() || vertex > records.back()) {
+            records.push_back(vertex);
+        }
+    }
+    return records;
+}
+
+template <typename Weight>
+bool Router<Weight>::IsPreferredOnTie(VertexId from, EdgeId candidate_edge, EdgeId current_edge,
+    const std::vector<std::optional<EdgeId>>& prev_edges) const {
+    // The all-pairs build splits an equal-weight route at its greatest intermediate vertex first
+    // and keeps the one found through the smallest vertex, then repeats that for the rest of the route.
+    // Comparing intermediate vertices that are greater than everything after them, largest first, gives the same choice
+    if (graph_.GetEdge(candidate_edge).from == graph_.GetEdge(current_edge).from) {
+        // parallel edges: the first one of the incidence list wins as in InitializeRoutesInternalData
+        return false;
+    }
+    const std::vector<VertexId> candidate_records = CollectRouteRecords(from, candidate_edge, prev_edges);
+    const std::vector<VertexId> current_records = CollectRouteRecords(from, current_edge, prev_edges);
+    return std::lexicographical_compare(candidate_records.rbegin(), candidate_records.rend(),
+        current_records.rbegin(), current_records.rend());
+}
+
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRouteDijkstra(VertexId from,
+    VertexId to) const {
+    const ShortestPathTree tree = BuildShortestPathTree(from, { to });
+    if (!tree.weights[to]) {
+        return std::nullopt;
+    }
+    return RouteInfo{ *tree.weights[to], CollectTreeEdges(tree, to) };
+}
+
+template <typename Weight>
+typename Router<Weight>::ShortestPathTree Router<Weight>::BuildShortestPathTree(VertexId from,
+    const std::vector<VertexId>& targets, std::optional<Weight> max_weight) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count) {
+        throw std::out_of_range("Vertex is out of graph");
+    }
+    // vertices settled later can't change the tree paths to the settled ones, so the search stops early
+    std::vector<bool> is_target(vertex_count, false);
+    size_t targets_left = 0;
+    for (const VertexId target : targets) {
+        if (target >= vertex_count) {
+            throw std::out_of_range("Vertex is out of graph");
+        }
+        if (!is_target[target]) {
+            is_target[target] = true;
+            ++targets_left;
+        }
+    }
+    ShortestPathTree tree{ std::vector<std::optional<Weight>>(vertex_count), std::vector<std::optional<EdgeId>>(vertex_count) };
+    auto& weights = tree.weights;
+    auto& prev_edges = tree.prev_edges;
+    std::vector<bool> settled(vertex_count, false);
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    weights[from] = ZERO_WEIGHT;
+    queue.push({ ZERO_WEIGHT, from });
+
+    while (!queue.empty()) {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+        if (settled[vertex]) {
+            continue;
+        }
+        settled[vertex] = true;
+        if (is_target[vertex] && --targets_left == 0) {
+            break;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (settled[edge.to]) {
+                continue;
+            }
+            const Weight candidate_weight = *weights[vertex] + edge.weight;
+            if (max_weight && *max_weight < candidate_weight) {
+                continue;
+            }
+            auto& weight_relaxing = weights[edge.to];
+            if (!weight_relaxing || candidate_weight < *weight_relaxing) {
+                weight_relaxing = candidate_weight;
+                prev_edges[edge.to] = edge_id;
+                queue.push({ candidate_weight, edge.to });
+            }
+            else if (!(*weight_relaxing < candidate_weight)
+                && IsPreferredOnTie(from, edge_id, *prev_edges[edge.to], prev_edges)) {
+                prev_edges[edge.to] = edge_id;
+            }
+        }
+    }
+
+    return tree;
+}
+
+template <typename Weight>
+std::vector<EdgeId> Router<Weight>::CollectTreeEdges(const ShortestPathTree& tree, VertexId to) const {
+    std::vector<EdgeId> edges;
+    for (std::optional<EdgeId> edge_id = tree.prev_edges[to];
+        edge_id;
+        edge_id = tree.prev_edges[graph_.GetEdge(*edge_id).from])
+    {
+        edges.push_back(*edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+    return edges;
 }
 
 }  //namespace graph
\ No newline at end of file
@@ -1,45 +1,117 @@
 #include "serialization.h"
 
+#include <algorithm>
+
 namespace serial {
 
 Serializator::Serializator(tc_serialize::TransportBase db)
 	:db_(std::move(db)) {}
 
-void SerializeTrCatalogue(std::ofstream& out_file, const RequestHandler& rh, const RenderSettings& rend_set, const TransportRouter& tr_router) {
+namespace {
+
+tr_cat::PerfectHash ExtractPerfectHash(const tc_serialize::PerfectHash& serial_hash) {
+	return tr_cat::PerfectHash{
+		std::vector<uint32_t>(serial_hash.displacements().begin(), serial_hash.displacements().end()),
+		std::vector<uint32_t>(serial_hash.slot_ids().begin(), serial_hash.slot_ids().end()) };
+}
+
+void FillPerfectHash(const tr_cat::PerfectHash& perfect_hash, tc_serialize::PerfectHash& serial_hash) {
+	*serial_hash.mutable_displacements() = { perfect_hash.displacements.begin(), perfect_hash.displacements.end() };
+	*serial_hash.mutable_slot_ids() = { perfect_hash.slot_ids.begin(), perfect_hash.slot_ids.end() };
+}
+
+tr_cat::PerfectHash ExtractMappedPerfectHash(const MappedBase& base, MappedSection displacements, MappedSection slot_ids) {
+	const MappedArray<uint32_t> mapped_displacements = base.GetArray<uint32_t>(displacements);
+	const MappedArray<uint32_t> mapped_slot_ids = base.GetArray<uint32_t>(slot_ids);
+	return tr_cat::PerfectHash{
+		std::vector<uint32_t>(mapped_displacements.begin(), mapped_displacements.end()),
+		std::vector<uint32_t>(mapped_slot_ids.begin(), mapped_slot_ids.end()) };
+}
+
+// id остановки или автобуса ребра в нумерации базы
+template <typename Ids>
+uint32_t ToBaseId(const EdgeInfo& info, const Ids& base_stop_ids, const Ids& base_bus_ids) {
+	return static_cast<uint32_t>(IsStopEdge(info.kind) ? base_stop_ids.at(info.id) : base_bus_ids.at(info.id));
+}
+
+// Граф из файла проверяется при загрузке: у испорченной базы смещения или концы рёбер
+// выходят за число вершин, и поиск читал бы за границами массивов
+void CheckMappedGraph(const MappedArray<graph::Edge<double>>& edges, const MappedArray<size_t>& incidence_offsets,
+	const MappedArray<graph::EdgeId>& incidence_edges) {
+	if (incidence_offsets.size == 0 || incidence_offsets[0] != 0
+		|| incidence_offsets[incidence_offsets.size - 1] != incidence_edges.size) {
+		throw MappedBaseError("Malformed graph of mapped base");
+	}
+	const size_t vertex_count = incidence_offsets.size - 1;
+	for (const graph::Edge<double>& edge : edges) {
+		if (edge.from >= vertex_count || edge.to >= vertex_count) {
+			throw MappedBaseError("Malformed graph of mapped base");
+		}
+	}
+	for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
+		if (incidence_offsets[vertex] > incidence_offsets[vertex + 1]) {
+			throw MappedBaseError("Malformed graph of mapped base");
+		}
+		for (size_t i = incidence_offsets[vertex]; i < incidence_offsets[vertex + 1]; ++i) {
+			if (incidence_edges[i] >= edges.size || edges[incidence_edges[i]].from != vertex) {
+				throw MappedBaseError("Malformed graph of mapped base");
+			}
+		}
+	}
+}
+
+} //namespace
+
+void SerializeTrCatalogue(std::ofstream& out_file, const RequestHandler& rh, const RenderSettings& rend_set, const TransportRouter& tr_router,
+	const SerializationSettings& serialization_set) {
 	Serializator serializator;
-	serializator.BuildStops(rh.GetStopsIndex());
-	serializator.BuildBuses(rh.GetAllBuses());
+	serializator.BuildStops(rh.GetSortedStops());
+	const std::vector<Bus*> sorted_buses = rh.GetSortedBuses();
+	serializator.BuildBuses(sorted_buses);
+	serializator.BuildBusStats(sorted_buses, rh.GetBusStats());
+	if (serialization_set.perfect_hash) {
+		serializator.BuildNamesPerfectHash();
+	}
 	serializator.BuildDistances(rh.GetDistances());
 	serializator.BuildRenderSettings(rend_set);
+	if (serialization_set.store_map) {
+		serializator.BuildMap(MapRenderer(rend_set, rh).DrawMap());
+	}
 	serializator.BuildRouter(tr_router);
 	serializator.SaveBaseToFile(out_file);
 }
 
-void Serializator::BuildStops(const std::map<std::string_view, Stop*>& stops) {
+void Serializator::BuildStops(const std::vector<Stop*>& stops) {
 	int i = 0;
-	for (const auto& [name, ptr] : stops) {
+	base_stop_ids_.assign(stops.size(), 0);
+	for (const Stop* ptr : stops) {
+		const std::string_view name = ptr->name;
 		tc_serialize::Stop* stop = db_.add_stops();
 		stop->set_name(std::string(name));
 		stop->set_id(i);
 		stops_map_[std::string(name)] = i;
+		base_stop_ids_.at(ptr->id) = i;
 		stop->set_lat(ptr->place.lat);
 		stop->set_lng(ptr->place.lng);
 		++i;
 	}
 }
 
-void Serializator::BuildDistances(const std::unordered_map<std::pair<Stop*, Stop*>, int, tr_cat::detail::PairPtrHasher>& distances) {
-	for (const auto& [stops, dist] : distances) {
+void Serializator::BuildDistances(const std::vector<RoadDistance>& distances) {
+	for (const RoadDistance& dist : distances) {
 		tc_serialize::Distance* dist_ser = db_.add_distances();
-		dist_ser->set_first_stop_id(stops_map_.at(stops.first->name));
-		dist_ser->set_second_stop_id(stops_map_.at(stops.second->name));
-		dist_ser->set_distance(dist);
+		dist_ser->set_first_stop_id(base_stop_ids_.at(dist.from));
+		dist_ser->set_second_stop_id(base_stop_ids_.at(dist.to));
+		dist_ser->set_distance(dist.distance);
 	}
 }
 
-void Serializator::BuildBuses(const std::map<std::string_view, Bus*> buses) {
+void Serializator::BuildBuses(const std::vector<Bus*>& buses) {
 	int j = 0;
-	for (const auto& [name, ptr] : buses) {
+	base_bus_ids_.assign(buses.size(), 0);
+	for (const Bus* ptr : buses) {
+		base_bus_ids_.at(ptr->id) = j;
+		const std::string_view name = ptr->name;
 		tc_serialize::Bus* bus = db_.add_buses();
 		bus->set_name(std::string(name));
 		bus->set_is_round(ptr->is_round);
@@ -62,6 +134,39 @@ void Serializator::BuildBuses(const std::map<std::string_view, Bus*> buses) {
 	
 }
 
+void Serializator::BuildBusStats(const std::vector<Bus*>& buses, const std::vector<BusStat>& bus_stats) {
+	for (int j = 0; j < static_cast<int>(buses.size()); ++j) {
+		const BusStat& bus_stat = bus_stats.at(buses[j]->id);
+		tc_serialize::BusStat* stat = db_.mutable_buses(j)->mutable_stat();
+		stat->set_route_length(bus_stat.route_length);
+		stat->set_geo_length(bus_stat.geo_length);
+		stat->set_curvature(bus_stat.curvature);
+		stat->set_stop_count(bus_stat.stop_count);
+		stat->set_unique_stop_count(bus_stat.unique_stop_count);
+	}
+}
+
+void Serializator::BuildNamesPerfectHash() {
+	std::vector<std::string_view> names;
+	for (const tc_serialize::Stop& stop : db_.stops()) {
+		names.push_back(stop.name());
+	}
+	FillPerfectHash(tr_cat::BuildPerfectHash(names), *db_.mutable_stop_names_hash());
+	names.clear();
+	for (const tc_serialize::Bus& bus : db_.buses()) {
+		names.push_back(bus.name());
+	}
+	FillPerfectHash(tr_cat::BuildPerfectHash(names), *db_.mutable_bus_names_hash());
+}
+
+void Serializator::BuildMap(std::string map_svg) {
+	db_.set_map_svg(std::move(map_svg));
+}
+
+std::string Serializator::ExtractMap() {
+	return std::move(*db_.mutable_map_svg());
+}
+
 void Serializator::BuildRenderSettings(const RenderSettings& rend_set) {
 	tc_serialize::RenderSettings* settings = db_.mutable_rend_set();
 	
@@ -93,16 +198,59 @@ void Serializator::BuildRouter(const TransportRouter& tr_router) {
 	*db_.mutable_graph() = tr_router.GetSerializedGraph();
 	*db_.mutable_router() = tr_router.GetSerializedRouter();
 	*db_.mutable_transport_router() = tr_router.GetSerializedTransportRouter(/*stops_map_, buses_map_*/);
+	const std::vector<EdgeInfo>& edge_infos = tr_router.GetIndex()->GetEdgeInfos();
+	tc_serialize::EdgeInfos* serial_infos = db_.mutable_transport_router()->mutable_edge_infos();
+	serial_infos->mutable_kinds()->Reserve(static_cast<int>(edge_infos.size()));
+	serial_infos->mutable_ids()->Reserve(static_cast<int>(edge_infos.size()));
+	serial_infos->mutable_span_counts()->Reserve(static_cast<int>(edge_infos.size()));
+	for (const EdgeInfo& info : edge_infos) {
+		serial_infos->add_kinds(static_cast<uint32_t>(info.kind));
+		serial_infos->add_ids(ToBaseId(info, base_stop_ids_, base_bus_ids_));
+		serial_infos->add_span_counts(info.span_count);
+	}
+	const Timetable::Data& timetable = tr_router.GetIndex()->GetTimetable().GetData();
+	tc_serialize::Timetable* serial_timetable = db_.mutable_transport_router()->mutable_timetable();
+	for (const Timetable::Pattern& pattern : timetable.patterns) {
+		serial_timetable->add_pattern_buses(static_cast<uint32_t>(base_bus_ids_.at(pattern.bus_id)));
+		serial_timetable->add_pattern_stop_counts(pattern.stop_count);
+		serial_timetable->add_headways(pattern.headway);
+		serial_timetable->add_first_departures(pattern.first_departure);
+		serial_timetable->add_last_departures(pattern.last_departure);
+	}
+	serial_timetable->mutable_stops()->Reserve(static_cast<int>(timetable.stops.size()));
+	for (StopId stop_id : timetable.stops) {
+		serial_timetable->add_stops(static_cast<uint32_t>(base_stop_ids_.at(stop_id)));
+	}
+	serial_timetable->mutable_offsets()->Add(timetable.offsets.begin(), timetable.offsets.end());
+}
+
+void Serializator::BuildRouterSettings(const TransportRouter& tr_router) {
+	*db_.mutable_transport_router() = tr_router.GetSerializedTransportRouter();
+	if (tr_router.GetRouter().GetEngine() == graph::RouterEngine::CONTRACTION_HIERARCHY) {
+		*db_.mutable_router() = tr_router.GetSerializedRouter();
+	}
 }
 
 void Serializator::SaveBaseToFile(std::ofstream& out_file) {
 	db_.SerializeToOstream(&out_file);
 }
 
+std::string Serializator::SaveBaseToString() const {
+	return db_.SerializeAsString();
+}
+
 void Serializator::BuildCatalogue(tr_cat::TransportCatalogue& tr_cat) {
 	AddStops(tr_cat);
 	AddDistances(tr_cat);
 	AddBuses(tr_cat);
+	AddBusStats(tr_cat);
+	// id в справочнике совпадают с номерами в базе, пока справочник заполняется только из неё
+	if (db_.has_stop_names_hash()) {
+		tr_cat.SetStopNamesPerfectHash(ExtractPerfectHash(db_.stop_names_hash()));
+	}
+	if (db_.has_bus_names_hash()) {
+		tr_cat.SetBusNamesPerfectHash(ExtractPerfectHash(db_.bus_names_hash()));
+	}
 }
 
 void Serializator::AddSettings(RenderSettings& rend_set) {
@@ -129,57 +277,410 @@ void Serializator::AddSettings(RenderSettings& rend_set) {
 void Serializator::SetRouterSettings(RouterSettings& r_set) {
 	r_set.bus_velocity_ = db_.transport_router().rout_set().bus_velocity();
 	r_set.bus_wait_time_ = db_.transport_router().rout_set().bus_wait_time();
+	// enum в proto3 открытый: из чужой или испорченной базы в движке и модели графа может прийти любое число
+	switch (db_.transport_router().rout_set().router_engine()) {
+	case tc_serialize::ALL_PAIRS:
+		r_set.router_engine_ = graph::RouterEngine::ALL_PAIRS;
+		break;
+	case tc_serialize::DIJKSTRA:
+		r_set.router_engine_ = graph::RouterEngine::DIJKSTRA;
+		break;
+	case tc_serialize::CONTRACTION_HIERARCHY:
+		r_set.router_engine_ = graph::RouterEngine::CONTRACTION_HIERARCHY;
+		break;
+	default:
+		throw std::invalid_argument("Unknown router engine "
+			+ std::to_string(db_.transport_router().rout_set().router_engine()) + " of the base");
+	}
+	switch (db_.transport_router().rout_set().graph_model()) {
+	case tc_serialize::SPAN_EDGES:
+		r_set.graph_model_ = GraphModel::SPAN_EDGES;
+		break;
+	case tc_serialize::ON_BOARD:
+		r_set.graph_model_ = GraphModel::ON_BOARD;
+		break;
+	default:
+		throw std::invalid_argument("Unknown graph model "
+			+ std::to_string(db_.transport_router().rout_set().graph_model()) + " of the base");
+	}
 }
 
-TransportRouter* DeserializeTrCatalogue(std::ifstream& in, tr_cat::TransportCatalogue& tr_cat, RenderSettings& rend_set, RouterSettings& r_set, RequestHandler& rh) {
+std::unique_ptr<TransportRouter> DeserializeTrCatalogue(std::ifstream& in, tr_cat::TransportCatalogue& tr_cat, RenderSettings& rend_set, RouterSettings& r_set,
+	std::string& map_svg) {
 	tc_serialize::TransportBase base;
 	bool parsed = base.ParseFromIstream(&in);
 	Serializator serializator(base);
 	serializator.BuildCatalogue(tr_cat);
 	serializator.AddSettings(rend_set);
-	graph::DirectedWeightedGraph<double>* graph = serializator.EctractGraph();
-	graph::Router<double>* router = serializator.ExtractRouter(*graph);
+	map_svg = serializator.ExtractMap();
 	serializator.SetRouterSettings(r_set);
-	TransportRouter* tr_router = serializator.ExtractTrRouter(tr_cat, r_set, graph, router, rh);
-	return tr_router;
+	std::unique_ptr<graph::DirectedWeightedGraph<double>> graph = serializator.EctractGraph();
+	std::unique_ptr<graph::Router<double>> router = serializator.ExtractRouter(*graph, r_set.router_engine_);
+	return serializator.ExtractTrRouter(tr_cat, r_set, std::move(graph), std::move(router), serializator.ExtractEdgeInfos(),
+		serializator.ExtractTimetable());
 }
 
-TransportRouter* Serializator::ExtractTrRouter(tr_cat::TransportCatalogue& tr_cat, RouterSettings r_set,
-	graph::DirectedWeightedGraph<double>* graph, graph::Router<double>* router, RequestHandler& rh) {
+void SerializeMappedTrCatalogue(std::ofstream& out_file, const RequestHandler& rh, const RenderSettings& rend_set, const TransportRouter& tr_router,
+	const SerializationSettings& serialization_set) {
+	Serializator serializator;
+	serializator.BuildRenderSettings(rend_set);
+	if (serialization_set.store_map) {
+		serializator.BuildMap(MapRenderer(rend_set, rh).DrawMap());
+	}
+	serializator.BuildRouterSettings(tr_router);
+	const std::string settings = serializator.SaveBaseToString();
+
+	std::vector<MappedStop> stops;
+	std::string stop_names;
+	const std::vector<Stop*> sorted_stops = rh.GetSortedStops();
+	std::vector<uint32_t> stop_ids(sorted_stops.size()); //по id остановки в справочнике
+	std::vector<std::string_view> sorted_stop_names;
+	for (const Stop* ptr : sorted_stops) {
+		const std::string_view name = ptr->name;
+		sorted_stop_names.push_back(name);
+		stop_ids.at(ptr->id) = static_cast<uint32_t>(stops.size());
+		stops.push_back(MappedStop{ stop_names.size(), name.size(), ptr->place.lat, ptr->place.lng });
+		stop_names += name;
+	}
+
+	const std::vector<BusStat>& all_bus_stats = rh.GetBusStats();
+	std::vector<MappedBus> buses;
+	std::vector<MappedBusStat> bus_stats;
+	std::string bus_names;
+	std::vector<uint32_t> bus_stops;
+	std::vector<std::string_view> sorted_bus_names;
+	const std::vector<Bus*> sorted_buses = rh.GetSortedBuses();
+	std::vector<uint32_t> bus_ids(sorted_buses.size()); //по id автобуса в справочнике
+	for (const Bus* ptr : sorted_buses) {
+		const std::string_view name = ptr->name;
+		bus_ids.at(ptr->id) = static_cast<uint32_t>(buses.size());
+		sorted_bus_names.push_back(name);
+		MappedBus bus;
+		bus.name_offset = bus_names.size();
+		bus.name_size = name.size();
+		bus.first_stop = bus_stops.size();
+		bus.is_round = ptr->is_round;
+		for (size_t i = 0; i < ptr->route.size(); ++i) {
+			bus_stops.push_back(stop_ids.at(ptr->route[i]->id));
+			++bus.stop_count;
+			if (i < ptr->half_route.size()) {
+				++bus.half_route_size;
+			}
+		}
+		buses.push_back(bus);
+		const BusStat& bus_stat = all_bus_stats.at(ptr->id);
+		bus_stats.push_back(MappedBusStat{ bus_stat.geo_length, bus_stat.curvature, bus_stat.route_length,
+			static_cast<uint32_t>(bus_stat.stop_count), static_cast<uint32_t>(bus_stat.unique_stop_count), 0 });
+		bus_names += name;
+	}
 
-	TransportRouter* tr_router = new TransportRouter(tr_cat, r_set, rh, graph, router);
-	return tr_router;
+	std::vector<MappedDistance> distances;
+	for (const RoadDistance& dist : rh.GetDistances()) {
+		distances.push_back(MappedDistance{ stop_ids.at(dist.from), stop_ids.at(dist.to), dist.distance });
+	}
+
+	const graph::DirectedWeightedGraph<double>& graph = tr_router.GetGraph();
+	std::vector<graph::Edge<double>> edges(graph.GetEdgeCount());
+	for (graph::EdgeId edge_id = 0; edge_id < edges.size(); ++edge_id) {
+		edges[edge_id] = graph.GetEdge(edge_id);
+	}
+	std::vector<size_t> incidence_offsets{ 0 };
+	std::vector<graph::EdgeId> incidence_edges;
+	incidence_edges.reserve(edges.size());
+	for (graph::VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+		for (graph::EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+			incidence_edges.push_back(edge_id);
+		}
+		incidence_offsets.push_back(incidence_edges.size());
+	}
+
+	MappedBaseWriter writer;
+	writer.AddSection(MappedSection::SETTINGS, settings.data(), settings.size());
+	writer.AddSection(MappedSection::STOPS, stops);
+	writer.AddSection(MappedSection::STOP_NAMES, stop_names.data(), stop_names.size());
+	writer.AddSection(MappedSection::BUSES, buses);
+	writer.AddSection(MappedSection::BUS_NAMES, bus_names.data(), bus_names.size());
+	writer.AddSection(MappedSection::BUS_STOPS, bus_stops);
+	writer.AddSection(MappedSection::DISTANCES, distances);
+	writer.AddSection(MappedSection::GRAPH_EDGES, edges);
+	writer.AddSection(MappedSection::INCIDENCE_OFFSETS, incidence_offsets);
+	writer.AddSection(MappedSection::INCIDENCE_EDGES, incidence_edges);
+	const graph::RoutesInternalData<double>& routes_internal_data = tr_router.GetRouter().GetRoutesInternalData();
+	const size_t cell_count = routes_internal_data.GetVertexCount() * routes_internal_data.GetVertexCount();
+	writer.AddSection(MappedSection::ROUTE_WEIGHTS, routes_internal_data.GetWeights(), cell_count * sizeof(double));
+	writer.AddSection(MappedSection::ROUTE_PREV_EDGES, routes_internal_data.GetPrevEdges(),
+		cell_count * sizeof(graph::RoutesInternalData<double>::CompactEdgeId));
+
+	tr_cat::PerfectHash stop_names_hash;
+	tr_cat::PerfectHash bus_names_hash;
+	if (serialization_set.perfect_hash) {
+		stop_names_hash = tr_cat::BuildPerfectHash(sorted_stop_names);
+		bus_names_hash = tr_cat::BuildPerfectHash(sorted_bus_names);
+	}
+	writer.AddSection(MappedSection::STOP_NAMES_HASH_DISPLACEMENTS, stop_names_hash.displacements);
+	writer.AddSection(MappedSection::STOP_NAMES_HASH_SLOTS, stop_names_hash.slot_ids);
+	writer.AddSection(MappedSection::BUS_NAMES_HASH_DISPLACEMENTS, bus_names_hash.displacements);
+	writer.AddSection(MappedSection::BUS_NAMES_HASH_SLOTS, bus_names_hash.slot_ids);
+	writer.AddSection(MappedSection::BUS_STATS, bus_stats);
+	std::vector<MappedEdgeInfo> edge_infos;
+	edge_infos.reserve(tr_router.GetIndex()->GetEdgeInfos().size());
+	for (const EdgeInfo& info : tr_router.GetIndex()->GetEdgeInfos()) {
+		edge_infos.push_back(MappedEdgeInfo{ ToBaseId(info, stop_ids, bus_ids), info.span_count, static_cast<uint32_t>(info.kind), 0 });
+	}
+	writer.AddSection(MappedSection::EDGE_INFOS, edge_infos);
+	const Timetable::Data& timetable = tr_router.GetIndex()->GetTimetable().GetData();
+	std::vector<MappedTimetablePattern> timetable_patterns;
+	timetable_patterns.reserve(timetable.patterns.size());
+	for (const Timetable::Pattern& pattern : timetable.patterns) {
+		timetable_patterns.push_back(MappedTimetablePattern{ bus_ids.at(pattern.bus_id), pattern.first_stop, pattern.stop_count, 0,
+			pattern.headway, pattern.first_departure, pattern.last_departure });
+	}
+	std::vector<uint32_t> timetable_stops;
+	timetable_stops.reserve(timetable.stops.size());
+	for (StopId stop_id : timetable.stops) {
+		timetable_stops.push_back(stop_ids.at(stop_id));
+	}
+	writer.AddSection(MappedSection::TIMETABLE_PATTERNS, timetable_patterns);
+	writer.AddSection(MappedSection::TIMETABLE_STOPS, timetable_stops);
+	writer.AddSection(MappedSection::TIMETABLE_OFFSETS, timetable.offsets);
+	writer.Write(out_file);
+}
+
+std::unique_ptr<TransportRouter> DeserializeMappedTrCatalogue(const std::filesystem::path& path, tr_cat::TransportCatalogue& tr_cat, RenderSettings& rend_set, RouterSettings& r_set,
+	std::string& map_svg) {
+	const MappedBase base(path);
+
+	tc_serialize::TransportBase settings;
+	const std::string_view settings_bytes = base.GetBytes(MappedSection::SETTINGS);
+	if (!settings.ParseFromArray(settings_bytes.data(), static_cast<int>(settings_bytes.size()))) {
+		throw MappedBaseError("Malformed settings of mapped base");
+	}
+	Serializator serializator(std::move(settings));
+	serializator.AddSettings(rend_set);
+	serializator.SetRouterSettings(r_set);
+	map_svg = serializator.ExtractMap();
+
+	const std::string_view stop_names = base.GetBytes(MappedSection::STOP_NAMES);
+	std::vector<Stop*> id_to_stop;
+	for (const MappedStop& stop : base.GetArray<MappedStop>(MappedSection::STOPS)) {
+		id_to_stop.push_back(tr_cat.AddStop(domain::MakeStop(
+			std::string(stop_names.substr(stop.name_offset, stop.name_size)), stop.lat, stop.lng)));
+	}
+	for (const MappedDistance& dist : base.GetArray<MappedDistance>(MappedSection::DISTANCES)) {
+		tr_cat.AddDistances({ { id_to_stop.at(dist.first_stop_id), id_to_stop.at(dist.second_stop_id) }, dist.distance });
+	}
+	const std::string_view bus_names = base.GetBytes(MappedSection::BUS_NAMES);
+	const MappedArray<uint32_t> bus_stops = base.GetArray<uint32_t>(MappedSection::BUS_STOPS);
+	for (const MappedBus& mapped_bus : base.GetArray<MappedBus>(MappedSection::BUSES)) {
+		if (mapped_bus.first_stop + mapped_bus.stop_count > bus_stops.size) {
+			throw MappedBaseError("Malformed bus section of mapped base");
+		}
+		Bus bus;
+		bus.name = std::string(bus_names.substr(mapped_bus.name_offset, mapped_bus.name_size));
+		bus.is_round = mapped_bus.is_round != 0;
+		bus.route.resize(mapped_bus.stop_count);
+		for (uint32_t j = 0; j < mapped_bus.stop_count; ++j) {
+			bus.route[j] = id_to_stop.at(bus_stops[mapped_bus.first_stop + j]);
+		}
+		bus.half_route.assign(bus.route.begin(), bus.route.begin() + std::min(mapped_bus.half_route_size, mapped_bus.stop_count));
+		tr_cat.AddBus(std::move(bus));
+	}
+	const MappedArray<MappedBusStat> mapped_bus_stats = base.GetArray<MappedBusStat>(MappedSection::BUS_STATS);
+	if (mapped_bus_stats.size != 0) {
+		std::vector<BusStat> bus_stats;
+		bus_stats.reserve(mapped_bus_stats.size);
+		for (const MappedBusStat& mapped_stat : mapped_bus_stats) {
+			BusStat bus_stat;
+			bus_stat.geo_length = mapped_stat.geo_length;
+			bus_stat.curvature = mapped_stat.curvature;
+			bus_stat.route_length = mapped_stat.route_length;
+			bus_stat.stop_count = static_cast<int>(mapped_stat.stop_count);
+			bus_stat.unique_stop_count = static_cast<int>(mapped_stat.unique_stop_count);
+			bus_stats.push_back(bus_stat);
+		}
+		tr_cat.SetBusStats(std::move(bus_stats));
+	}
+	if (!base.GetBytes(MappedSection::STOP_NAMES_HASH_SLOTS).empty()) {
+		tr_cat.SetStopNamesPerfectHash(ExtractMappedPerfectHash(base, MappedSection::STOP_NAMES_HASH_DISPLACEMENTS, MappedSection::STOP_NAMES_HASH_SLOTS));
+	}
+	if (!base.GetBytes(MappedSection::BUS_NAMES_HASH_SLOTS).empty()) {
+		tr_cat.SetBusNamesPerfectHash(ExtractMappedPerfectHash(base, MappedSection::BUS_NAMES_HASH_DISPLACEMENTS, MappedSection::BUS_NAMES_HASH_SLOTS));
+	}
+
+	const MappedArray<graph::Edge<double>> edges = base.GetArray<graph::Edge<double>>(MappedSection::GRAPH_EDGES);
+	const MappedArray<size_t> incidence_offsets = base.GetArray<size_t>(MappedSection::INCIDENCE_OFFSETS);
+	const MappedArray<graph::EdgeId> incidence_edges = base.GetArray<graph::EdgeId>(MappedSection::INCIDENCE_EDGES);
+	CheckMappedGraph(edges, incidence_offsets, incidence_edges);
+	const size_t vertex_count = incidence_offsets.size - 1;
+	auto graph = std::make_unique<graph::DirectedWeightedGraph<double>>(edges.data, edges.size,
+		incidence_offsets.data, incidence_edges.data, vertex_count, base.GetStorage());
+
+	std::unique_ptr<graph::Router<double>> router;
+	if (r_set.router_engine_ == graph::RouterEngine::CONTRACTION_HIERARCHY) {
+		router = std::make_unique<graph::Router<double>>(*graph, serializator.ExtractContractionHierarchy(*graph));
+	}
+	else if (r_set.router_engine_ != graph::RouterEngine::ALL_PAIRS) {
+		router = std::make_unique<graph::Router<double>>(*graph, r_set.router_engine_);
+	}
+	else {
+		using CompactEdgeId = graph::RoutesInternalData<double>::CompactEdgeId;
+		const MappedArray<double> weights = base.GetArray<double>(MappedSection::ROUTE_WEIGHTS);
+		const MappedArray<CompactEdgeId> prev_edges = base.GetArray<CompactEdgeId>(MappedSection::ROUTE_PREV_EDGES);
+		if (weights.size != vertex_count * vertex_count || prev_edges.size != weights.size) {
+			throw MappedBaseError("Malformed routing table of mapped base");
+		}
+		router = std::make_unique<graph::Router<double>>(*graph, graph::RoutesInternalData<double>(vertex_count,
+			weights.data, prev_edges.data, base.GetStorage()));
+	}
+	std::optional<std::vector<EdgeInfo>> edge_infos;
+	const MappedArray<MappedEdgeInfo> mapped_edge_infos = base.GetArray<MappedEdgeInfo>(MappedSection::EDGE_INFOS);
+	if (mapped_edge_infos.size != 0) {
+		edge_infos.emplace();
+		edge_infos->reserve(mapped_edge_infos.size);
+		for (const MappedEdgeInfo& info : mapped_edge_infos) {
+			edge_infos->push_back(EdgeInfo{ info.id, info.span_count, static_cast<EdgeKind>(info.kind) });
+		}
+	}
+	std::optional<Timetable::Data> timetable;
+	const MappedArray<MappedTimetablePattern> timetable_patterns = base.GetArray<MappedTimetablePattern>(MappedSection::TIMETABLE_PATTERNS);
+	if (timetable_patterns.size != 0) {
+		const MappedArray<uint32_t> timetable_stops = base.GetArray<uint32_t>(MappedSection::TIMETABLE_STOPS);
+		const MappedArray<double> timetable_offsets = base.GetArray<double>(MappedSection::TIMETABLE_OFFSETS);
+		timetable.emplace();
+		timetable->patterns.reserve(timetable_patterns.size);
+		for (const MappedTimetablePattern& pattern : timetable_patterns) {
+			timetable->patterns.push_back(Timetable::Pattern{ pattern.bus_id, pattern.first_stop, pattern.stop_count,
+				pattern.headway, pattern.first_departure, pattern.last_departure });
+		}
+		timetable->stops.assign(timetable_stops.begin(), timetable_stops.end());
+		timetable->offsets.assign(timetable_offsets.begin(), timetable_offsets.end());
+	}
+	return serializator.ExtractTrRouter(tr_cat, r_set, std::move(graph), std::move(router), std::move(edge_infos), std::move(timetable));
+}
+
+std::unique_ptr<TransportRouter> Serializator::ExtractTrRouter(const tr_cat::TransportCatalogue& tr_cat, RouterSettings r_set,
+	std::unique_ptr<graph::DirectedWeightedGraph<double>> graph, std::unique_ptr<graph::Router<double>> router,
+	std::optional<std::vector<EdgeInfo>> edge_infos, std::optional<Timetable::Data> timetable) {
+
+	return std::make_unique<TransportRouter>(r_set, RoutingIndex::Load(tr_cat, r_set, std::move(graph), std::move(router),
+		std::move(edge_infos), std::move(timetable)));
 }
 
+std::optional<std::vector<EdgeInfo>> Serializator::ExtractEdgeInfos() const {
+	if (!db_.transport_router().has_edge_infos()) {
+		return std::nullopt;
+	}
+	const tc_serialize::EdgeInfos& serial_infos = db_.transport_router().edge_infos();
+	if (serial_infos.ids_size() != serial_infos.kinds_size() || serial_infos.span_counts_size() != serial_infos.kinds_size()) {
+		throw std::invalid_argument("Malformed edge infos of the base");
+	}
+	std::vector<EdgeInfo> edge_infos(serial_infos.kinds_size());
+	for (int i = 0; i < serial_infos.kinds_size(); ++i) {
+		edge_infos[i] = EdgeInfo{ serial_infos.ids(i), serial_infos.span_counts(i), static_cast<EdgeKind>(serial_infos.kinds(i)) };
+	}
+	return edge_infos;
+}
 
-graph::Router<double>* Serializator::ExtractRouter(const graph::DirectedWeightedGraph<double>& graph) {
+std::optional<Timetable::Data> Serializator::ExtractTimetable() const {
+	if (!db_.transport_router().has_timetable()) {
+		return std::nullopt;
+	}
+	const tc_serialize::Timetable& serial_timetable = db_.transport_router().timetable();
+	const int pattern_count = serial_timetable.pattern_buses_size();
+	if (serial_timetable.pattern_stop_counts_size() != pattern_count || serial_timetable.headways_size() != pattern_count
+		|| serial_timetable.first_departures_size() != pattern_count || serial_timetable.last_departures_size() != pattern_count) {
+		throw std::invalid_argument("Malformed timetable of the base");
+	}
+	Timetable::Data timetable;
+	timetable.patterns.reserve(pattern_count);
+	uint32_t first_stop = 0;
+	for (int i = 0; i < pattern_count; ++i) {
+		timetable.patterns.push_back(Timetable::Pattern{ serial_timetable.pattern_buses(i), first_stop, serial_timetable.pattern_stop_counts(i),
+			serial_timetable.headways(i), serial_timetable.first_departures(i), serial_timetable.last_departures(i) });
+		first_stop += serial_timetable.pattern_stop_counts(i);
+	}
+	timetable.stops.assign(serial_timetable.stops().begin(), serial_timetable.stops().end());
+	timetable.offsets.assign(serial_timetable.offsets().begin(), serial_timetable.offsets().end());
+	return timetable;
+}
+
+
+std::unique_ptr<graph::Router<double>> Serializator::ExtractRouter(const graph::DirectedWeightedGraph<double>& graph, graph::RouterEngine engine) {
+	if (engine == graph::RouterEngine::CONTRACTION_HIERARCHY) {
+		return std::make_unique<graph::Router<double>>(graph, ExtractContractionHierarchy(graph));
+	}
+	if (engine != graph::RouterEngine::ALL_PAIRS) {
+		return std::make_unique<graph::Router<double>>(graph, engine);
+	}
+
+	// база с неизвестной раскладкой таблицы не читается как одна из известных
+	if (db_.router().version() > 1) {
+		throw std::invalid_argument("Unknown routing table version " + std::to_string(db_.router().version()) + " of the base");
+	}
+	if (db_.router().version() == 1) {
+		return std::make_unique<graph::Router<double>>(graph, ExtractPackedRoutesInternalData(graph));
+	}
 
-	graph::RoutesInternalData<double> madness(db_.router().routes_internal_data_size());
-	for (int i = 0; i < madness.size(); ++i) {
-		madness[i].resize(db_.router().routes_internal_data(i).vector_route_size());
-		for (int j = 0; j < madness[i].size(); ++j) {
-			//deal with this later
-			if (db_.router().routes_internal_data(i).vector_route(j).has_v() == false) {
-				madness[i][j] = std::nullopt;
+	//version 0
+	const size_t vertex_count = db_.router().routes_internal_data_size();
+	if (vertex_count != graph.GetVertexCount()) {
+		throw std::invalid_argument("Routing table doesn't match the graph");
+	}
+	graph::RoutesInternalData<double> routes_internal_data(vertex_count);
+	for (size_t i = 0; i < vertex_count; ++i) {
+		const tc_serialize::VectorRouteInternalData& row = db_.router().routes_internal_data(i);
+		for (size_t j = 0; j < vertex_count && j < static_cast<size_t>(row.vector_route_size()); ++j) {
+			const tc_serialize::RouteInternalData& data = row.vector_route(j);
+			if (!data.has_v()) {
+				continue;
 			}
-			else {
-				graph::RouteInternalData<double> something;
-				something.weight = db_.router().routes_internal_data(i).vector_route(j).weight();
-				if (db_.router().routes_internal_data(i).vector_route(j).has_prev_edge()) {
-					something.prev_edge = db_.router().routes_internal_data(i).vector_route(j).prev_edge().prev_edge_id();
+			std::optional<graph::EdgeId> prev_edge;
+			if (data.has_prev_edge()) {
+				if (data.prev_edge().prev_edge_id() >= graph.GetEdgeCount()) {
+					throw std::invalid_argument("Routing table doesn't match the graph");
 				}
-				else {
-					something.prev_edge = std::nullopt;
-				}
-				madness[i][j] = something;
+				prev_edge = data.prev_edge().prev_edge_id();
 			}
+			routes_internal_data.SetRoute(i, j, data.weight(), prev_edge);
 		}
 	}
-	graph::Router<double>* router = new graph::Router<double>(graph, madness);
-	return router;
+	return std::make_unique<graph::Router<double>>(graph, std::move(routes_internal_data));
 }
 
-graph::DirectedWeightedGraph<double>* Serializator::EctractGraph() {
+graph::RoutesInternalData<double> Serializator::ExtractPackedRoutesInternalData(const graph::DirectedWeightedGraph<double>& graph) {
+	using CompactEdgeId = graph::RoutesInternalData<double>::CompactEdgeId;
+	const tc_serialize::PackedRoutesInternalData& packed = db_.router().packed_routes_internal_data();
+	// таблица другого размера или с чужими рёбрами читала бы за границами при сборке маршрута
+	if (packed.vertex_count() != graph.GetVertexCount()) {
+		throw std::invalid_argument("Routing table doesn't match the graph");
+	}
+	std::vector<double> weights(packed.weights().begin(), packed.weights().end());
+	std::vector<CompactEdgeId> prev_edges(packed.prev_edges_size());
+	for (int i = 0; i < packed.prev_edges_size(); ++i) {
+		if (packed.prev_edges(i) >= 0 && static_cast<size_t>(packed.prev_edges(i)) >= graph.GetEdgeCount()) {
+			throw std::invalid_argument("Routing table doesn't match the graph");
+		}
+		prev_edges[i] = packed.prev_edges(i) < 0
+			? graph::RoutesInternalData<double>::NO_PREV_EDGE : static_cast<CompactEdgeId>(packed.prev_edges(i));
+	}
+	return graph::RoutesInternalData<double>(packed.vertex_count(), std::move(weights), std::move(prev_edges));
+}
+
+graph::ContractionHierarchy<double> Serializator::ExtractContractionHierarchy(const graph::DirectedWeightedGraph<double>& graph) {
+	const tc_serialize::ContractionHierarchy& serial_hierarchy = db_.router().contraction_hierarchy();
+	std::vector<size_t> ranks(serial_hierarchy.ranks().begin(), serial_hierarchy.ranks().end());
+	std::vector<graph::ContractionHierarchy<double>::Arc> shortcuts(serial_hierarchy.shortcuts_size());
+	for (int i = 0; i < serial_hierarchy.shortcuts_size(); ++i) {
+		const tc_serialize::Shortcut& shortcut = serial_hierarchy.shortcuts(i);
+		shortcuts[i].from = shortcut.vertex_from();
+		shortcuts[i].to = shortcut.vertex_to();
+		shortcuts[i].weight = shortcut.weight();
+		shortcuts[i].children = std::make_pair(shortcut.first_arc(), shortcut.second_arc());
+	}
+	return graph::ContractionHierarchy<double>(graph, std::move(ranks), std::move(shortcuts));
+}
+
+std::unique_ptr<graph::DirectedWeightedGraph<double>> Serializator::EctractGraph() {
 
 	std::vector<graph::Edge<double>> edges(db_.graph().edges_size());
 	for (int i = 0; i < db_.graph().edges_size(); ++i) {
@@ -197,8 +698,7 @@ graph::DirectedWeightedGraph<double>* Serializator::EctractGraph() {
 			incidence_lists[i][j] = db_.graph().incidence_lists(i).edge_id_incidence_list(j);
 		}
 	}
-	graph::DirectedWeightedGraph<double>* graph = new graph::DirectedWeightedGraph<double>(edges, incidence_lists);
-	return graph;
+	return std::make_unique<graph::DirectedWeightedGraph<double>>(std::move(edges), std::move(incidence_lists));
 }
 
 void Serializator::AddStops(tr_cat::TransportCatalogue& tr_cat) {
@@ -232,7 +732,6 @@ void Serializator::AddBuses(tr_cat::TransportCatalogue& tr_cat) {
 		bus.half_route.resize(db_.buses(i).half_route_size());
 		for (int j = 0; j < db_.buses(i).route_size(); ++j) {
 			bus.route[j] = id_to_stop_.count(db_.buses(i).route(j)) ? id_to_stop_.at(db_.buses(i).route(j)) : nullptr;
-			bus.unique_stops.insert(bus.route[j]);
 			if (!bus.half_route.empty() && j < bus.half_route.size()) {
 				bus.half_route[j] = bus.route[j];
 			}
@@ -242,6 +741,26 @@ void Serializator::AddBuses(tr_cat::TransportCatalogue& tr_cat) {
 	}
 }
 
+// базы, записанные до появления статистики, её не содержат - тогда она посчитается при первом запросе
+void Serializator::AddBusStats(tr_cat::TransportCatalogue& tr_cat) {
+	std::vector<BusStat> bus_stats;
+	bus_stats.reserve(db_.buses_size());
+	for (const tc_serialize::Bus& bus : db_.buses()) {
+		if (!bus.has_stat()) {
+			return;
+		}
+		const tc_serialize::BusStat& stat = bus.stat();
+		BusStat bus_stat;
+		bus_stat.route_length = stat.route_length();
+		bus_stat.geo_length = stat.geo_length();
+		bus_stat.curvature = stat.curvature();
+		bus_stat.stop_count = stat.stop_count();
+		bus_stat.unique_stop_count = stat.unique_stop_count();
+		bus_stats.push_back(bus_stat);
+	}
+	tr_cat.SetBusStats(std::move(bus_stats));
+}
+
 tc_serialize::Color FormatColor(svg::Color svg_color) {
 	tc_serialize::Color color;
 
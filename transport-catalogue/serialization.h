@@ -5,18 +5,32 @@
 #include "request_handler.h"
 #include "map_renderer.h"
 #include "transport_router.h"
+#include "mapped_base.h"
 
 #include <transport_catalogue.pb.h>
 
 #include <string>
+#include <filesystem>
 #include <fstream>
 #include <unordered_map>
 #include <map>
+#include <memory>
+#include <optional>
+#include <vector>
 
 namespace serial {
     
+// MAPPED - бинарный формат из mapped_base.h, process_requests работает с ним без десериализации
+enum class BaseFormat {
+	PROTOBUF,
+	MAPPED,
+};
+
 struct SerializationSettings {
 	std::string file_name;
+	BaseFormat format = BaseFormat::PROTOBUF;
+	bool perfect_hash = false; //сохранять идеальные хеш-функции имён остановок и автобусов
+	bool store_map = false; //сохранять нарисованную карту
 };
 
 class Serializator {
@@ -24,25 +38,42 @@ public:
 	Serializator() = default;
 	Serializator(tc_serialize::TransportBase db_);
 
-	void BuildStops(const std::map<std::string_view, Stop*>& stops);
-	void BuildDistances(const std::unordered_map<std::pair<Stop*, Stop*>, int, tr_cat::detail::PairPtrHasher>& distances);
-	void BuildBuses(const std::map<std::string_view, Bus*> buses);
+	void BuildStops(const std::vector<Stop*>& stops);
+	void BuildDistances(const std::vector<RoadDistance>& distances); //после BuildStops
+	void BuildBuses(const std::vector<Bus*>& buses);
+	void BuildBusStats(const std::vector<Bus*>& buses, const std::vector<BusStat>& bus_stats); //после BuildBuses, bus_stats по id
+	void BuildNamesPerfectHash(); //после BuildStops и BuildBuses
 	void BuildRenderSettings(const RenderSettings& rend_set);
-	void BuildRouter(const TransportRouter& tr_router);
+	void BuildMap(std::string map_svg);
+	void BuildRouter(const TransportRouter& tr_router); //после BuildStops и BuildBuses
+	void BuildRouterSettings(const TransportRouter& tr_router); //без графа и таблицы маршрутов
 	void SaveBaseToFile(std::ofstream& out_file);
+	std::string SaveBaseToString() const;
 
 	void BuildCatalogue(tr_cat::TransportCatalogue& tr_cat);
 	void AddSettings(RenderSettings& rend_set);
-
-	graph::DirectedWeightedGraph<double>* EctractGraph();
-	graph::Router<double>* ExtractRouter(const graph::DirectedWeightedGraph<double>& graph);
+	// пустая строка, если карты в базе нет
+	std::string ExtractMap();
+
+	std::unique_ptr<graph::DirectedWeightedGraph<double>> EctractGraph();
+	// маршрутизатор ссылается на graph, он должен жить не меньше
+	std::unique_ptr<graph::Router<double>> ExtractRouter(const graph::DirectedWeightedGraph<double>& graph, graph::RouterEngine engine);
+	graph::RoutesInternalData<double> ExtractPackedRoutesInternalData(const graph::DirectedWeightedGraph<double>& graph);
+	graph::ContractionHierarchy<double> ExtractContractionHierarchy(const graph::DirectedWeightedGraph<double>& graph);
 	void SetRouterSettings(RouterSettings& r_set);
-	TransportRouter* ExtractTrRouter(tr_cat::TransportCatalogue& tr_cat, RouterSettings r_set, 
-		graph::DirectedWeightedGraph<double>* graph, graph::Router<double>* router, RequestHandler& rh);
+	// nullopt, если база записана без описаний рёбер
+	std::optional<std::vector<EdgeInfo>> ExtractEdgeInfos() const;
+	// nullopt, если база записана без расписания
+	std::optional<Timetable::Data> ExtractTimetable() const;
+	std::unique_ptr<TransportRouter> ExtractTrRouter(const tr_cat::TransportCatalogue& tr_cat, RouterSettings r_set,
+		std::unique_ptr<graph::DirectedWeightedGraph<double>> graph, std::unique_ptr<graph::Router<double>> router,
+		std::optional<std::vector<EdgeInfo>> edge_infos, std::optional<Timetable::Data> timetable);
 
 private:
 	tc_serialize::TransportBase db_;
 	std::unordered_map<std::string, int> stops_map_;
+	std::vector<int> base_stop_ids_; //по id остановки в справочнике
+	std::vector<int> base_bus_ids_; //по id автобуса в справочнике
 	std::unordered_map<int32_t, Stop*> id_to_stop_;
 
 	std::unordered_map<std::string, int> buses_map_;
@@ -51,11 +82,22 @@ private:
 	void AddStops(tr_cat::TransportCatalogue& tr_cat);
 	void AddDistances(tr_cat::TransportCatalogue& tr_cat);
 	void AddBuses(tr_cat::TransportCatalogue& tr_cat);
+	void AddBusStats(tr_cat::TransportCatalogue& tr_cat);
 };
 
-void SerializeTrCatalogue(std::ofstream& out_file, const RequestHandler& rh, const RenderSettings& rend_set, const TransportRouter& tr_router);
+void SerializeTrCatalogue(std::ofstream& out_file, const RequestHandler& rh, const RenderSettings& rend_set, const TransportRouter& tr_router,
+	const SerializationSettings& serialization_set);
+
+// map_svg получает карту из базы или пустую строку
+std::unique_ptr<TransportRouter> DeserializeTrCatalogue(std::ifstream& in, tr_cat::TransportCatalogue& tr_cat, RenderSettings& rend_set, RouterSettings& r_set,
+	std::string& map_svg);
+
+void SerializeMappedTrCatalogue(std::ofstream& out_file, const RequestHandler& rh, const RenderSettings& rend_set, const TransportRouter& tr_router,
+	const SerializationSettings& serialization_set);
 
-TransportRouter* DeserializeTrCatalogue(std::ifstream& in, tr_cat::TransportCatalogue& tr_cat, RenderSettings& rend_set, RouterSettings& r_set, RequestHandler& rh);
+// граф и таблица маршрутов остаются в отображённом файле, справочник заполняется из секций без protobuf
+std::unique_ptr<TransportRouter> DeserializeMappedTrCatalogue(const std::filesystem::path& path, tr_cat::TransportCatalogue& tr_cat, RenderSettings& rend_set, RouterSettings& r_set,
+	std::string& map_svg);
 
 tc_serialize::Color FormatColor(svg::Color svg_color);
 
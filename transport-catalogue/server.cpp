@@ -0,0 +1,366 @@
+#include "server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <system_error>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std::literals;
+
+namespace server {
+
+LoadedBase::LoadedBase(const std::filesystem::path& config, size_t reply_cache_size)
+    : reply_cache_(reply_cache_size) {
+    std::ifstream input(config, std::ios::binary);
+    if (!input) {
+        throw ReadJSONError("Cannot open config " + config.string());
+    }
+    reader_.LoadBase(input);
+}
+
+void LoadedBase::AnswerStatRequest(json::Writer& writer, const json::arena::Node& request) {
+    reader_.AnswerStatRequest(writer, request);
+}
+
+ReplyCache& LoadedBase::GetReplyCache() {
+    return reply_cache_;
+}
+
+namespace {
+
+// строки длиннее не копятся: клиент, который шлёт байты без перевода строки, отключается
+const size_t MAX_REQUEST_LINE_SIZE = 16 * 1024 * 1024;
+
+std::string ErrorReply(std::optional<int> id, std::string_view message) {
+    std::ostringstream output;
+    json::Writer writer(output, json::Writer::DEFAULT_BUFFER_SIZE, json::Writer::Layout::ONE_LINE);
+    writer.StartDict().Key("error_message"sv).Value(message);
+    if (id) {
+        writer.Key("request_id"sv).Value(*id);
+    }
+    writer.EndDict().Finish();
+    return output.str();
+}
+
+bool IsStatRequestType(std::string_view type) {
+    return type == "Stop"sv || type == "Bus"sv || type == "Route"sv || type == "RouteMatrix"sv || type == "Isochrone"sv
+        || type == "Map"sv;
+}
+
+// Ключ кэша: ответ на Route без departure_time зависит только от остановок, на Bus - от имени.
+// Длина первого имени в ключе отделяет его от второго. nullopt - ответ не кэшируется
+std::optional<std::string> ReplyCacheKey(const json::arena::Dict& request, std::string_view type) {
+    if (type == "Route"sv && request.count("from"sv) && request.count("to"sv) && !request.count("departure_time"sv)) {
+        const std::string_view from = request.at("from"sv).AsString();
+        const std::string_view to = request.at("to"sv).AsString();
+        std::string key = "R"s + std::to_string(from.size()) + ':';
+        key.append(from).append(to);
+        return key;
+    }
+    if (type == "Bus"sv && request.count("name"sv)) {
+        std::string key = "B"s;
+        key.append(request.at("name"sv).AsString());
+        return key;
+    }
+    return std::nullopt;
+}
+
+// Делит ответ вокруг номера запроса. Внутри строк кавычки экранированы, поэтому
+// "request_id": встречается только как ключ ответа
+std::optional<CachedReply> SplitReply(const std::string& reply, int id) {
+    const std::string key = "\"request_id\":"s;
+    const std::string id_text = std::to_string(id);
+    const size_t key_pos = reply.find(key);
+    if (key_pos == std::string::npos || reply.compare(key_pos + key.size(), id_text.size(), id_text) != 0) {
+        return std::nullopt;
+    }
+    const size_t suffix_pos = key_pos + key.size() + id_text.size();
+    return CachedReply{ reply.substr(0, key_pos + key.size()), reply.substr(suffix_pos) };
+}
+
+// строки могут приходить с \r\n
+std::string_view TrimLine(std::string_view line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    return line;
+}
+
+// false, если клиент отключился
+bool SendAll(int socket, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t sent = send(socket, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+[[noreturn]] void ThrowSystemError(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+} //namespace
+
+Server::Server(std::filesystem::path config, size_t reply_cache_size)
+    : config_(std::move(config))
+    , reply_cache_size_(reply_cache_size)
+    , base_(std::make_shared<LoadedBase>(config_, reply_cache_size_)) {
+}
+
+Server::~Server() {
+    StopClients();
+}
+
+std::string Server::Answer(std::string_view line) {
+    line = TrimLine(line);
+    if (line.find_first_not_of(" \t"sv) == std::string_view::npos) {
+        return {};
+    }
+    std::optional<int> id;
+    std::ostringstream output;
+    try {
+        const json::arena::Document document = json::arena::Load(line);
+        const json::arena::Node& request = document.GetRoot();
+        if (!request.IsDict() || !request.AsDict().count("type"sv) || !request.AsDict().count("id"sv)) {
+            throw ReadJSONError("Unexpected format of stat request");
+        }
+        id = request.AsDict().at("id"sv).AsInt();
+        const std::string_view type = request.AsDict().at("type"sv).AsString();
+        if (type == "Reload"sv) {
+            return AnswerReload(request);
+        }
+        if (type == "CacheStats"sv) {
+            return AnswerCacheStats(request);
+        }
+        if (!IsStatRequestType(type)) {
+            throw ReadJSONError("Unknown request type");
+        }
+        // база держится до конца ответа, даже если её уже подменила перезагрузка
+        const std::shared_ptr<LoadedBase> base = std::atomic_load(&base_);
+        ReplyCache& cache = base->GetReplyCache();
+        const std::optional<std::string> cache_key = cache.IsEnabled()
+            ? ReplyCacheKey(request.AsDict(), type) : std::nullopt;
+        if (cache_key) {
+            if (std::optional<std::string> reply = cache.Get(*cache_key, *id)) {
+                return std::move(*reply);
+            }
+        }
+        json::Writer writer(output, json::Writer::DEFAULT_BUFFER_SIZE, json::Writer::Layout::ONE_LINE);
+        base->AnswerStatRequest(writer, request);
+        writer.Finish();
+        if (cache_key) {
+            std::string reply = output.str();
+            if (std::optional<CachedReply> cached = SplitReply(reply, *id)) {
+                cache.Put(std::move(*cache_key), std::move(*cached));
+            }
+            return reply;
+        }
+    }
+    catch (const std::exception& e) {
+        return ErrorReply(id, e.what());
+    }
+    return output.str();
+}
+
+void Server::ServeStream(std::istream& input, std::ostream& output) {
+    std::string line;
+    while (std::getline(input, line)) {
+        const std::string reply = Answer(line);
+        if (!reply.empty()) {
+            output << reply << '\n';
+            output.flush();
+        }
+    }
+}
+
+void Server::ServeSocket(const std::filesystem::path& socket_path) {
+    const std::string path = socket_path.string();
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Socket path is too long");
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        ThrowSystemError("socket");
+    }
+    // сокет, оставшийся от прошлого запуска, мешает bind
+    struct stat status;
+    if (lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+        unlink(path.c_str());
+    }
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0
+        || listen(listener, SOMAXCONN) < 0) {
+        const int error = errno;
+        close(listener);
+        throw std::system_error(error, std::generic_category(), "bind");
+    }
+
+    while (true) {
+        const int client_socket = accept(listener, nullptr, nullptr);
+        if (client_socket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            const int error = errno;
+            close(listener);
+            StopClients();
+            throw std::system_error(error, std::generic_category(), "accept");
+        }
+        JoinFinishedClients();
+        std::lock_guard lock(clients_mutex_);
+        if (clients_.size() >= MAX_CLIENTS) {
+            SendAll(client_socket, ErrorReply(std::nullopt, "Too many clients") + '\n');
+            close(client_socket);
+            continue;
+        }
+        clients_.push_back(Client{ std::thread(&Server::ServeClient, this, client_socket), client_socket });
+    }
+}
+
+void Server::Reload() {
+    std::lock_guard lock(reload_mutex_);
+    ReplaceBase(config_);
+}
+
+void Server::ReplaceBase(const std::filesystem::path& config) {
+    // новая база загружается целиком, пока старая отвечает на запросы
+    std::shared_ptr<LoadedBase> base = std::make_shared<LoadedBase>(config, reply_cache_size_);
+    std::atomic_store(&base_, std::move(base));
+}
+
+std::string Server::AnswerReload(const json::arena::Node& request) {
+    const json::arena::Dict request_map = request.AsDict();
+    // путь к базе задаёт только --config: клиент не должен заставлять сервер открывать другие файлы
+    if (request_map.count("config"sv)) {
+        throw ReadJSONError("Reload takes no config, the server reloads its --config");
+    }
+    Reload();
+    std::ostringstream output;
+    json::Writer writer(output, json::Writer::DEFAULT_BUFFER_SIZE, json::Writer::Layout::ONE_LINE);
+    writer.StartDict()
+            .Key("reloaded"sv).Value(true)
+            .Key("request_id"sv).Value(request_map.at("id"sv).AsInt())
+          .EndDict().Finish();
+    return output.str();
+}
+
+std::string Server::AnswerCacheStats(const json::arena::Node& request) {
+    const ReplyCache::Stats stats = std::atomic_load(&base_)->GetReplyCache().GetStats();
+    // счётчики долго работающего сервера могут не поместиться в int
+    auto count = [](uint64_t value) {
+        return std::to_string(value);
+    };
+    std::ostringstream output;
+    json::Writer writer(output, json::Writer::DEFAULT_BUFFER_SIZE, json::Writer::Layout::ONE_LINE);
+    writer.StartDict()
+            .Key("capacity"sv).Value(json::RawJson{ count(stats.capacity) })
+            .Key("evictions"sv).Value(json::RawJson{ count(stats.evictions) })
+            .Key("hits"sv).Value(json::RawJson{ count(stats.hits) })
+            .Key("misses"sv).Value(json::RawJson{ count(stats.misses) })
+            .Key("request_id"sv).Value(request.AsDict().at("id"sv).AsInt())
+            .Key("size"sv).Value(json::RawJson{ count(stats.size) })
+          .EndDict().Finish();
+    return output.str();
+}
+
+void Server::ServeClient(int client_socket) {
+    std::string pending;
+    std::string buffer(64 * 1024, '\0');
+    bool connected = true;
+    while (connected) {
+        const ssize_t received = recv(client_socket, buffer.data(), buffer.size(), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            break;
+        }
+        pending.append(buffer.data(), static_cast<size_t>(received));
+        size_t line_begin = 0;
+        for (size_t line_end = pending.find('\n'); connected && line_end != std::string::npos;
+            line_end = pending.find('\n', line_begin)) {
+            std::string reply = Answer(std::string_view(pending).substr(line_begin, line_end - line_begin));
+            line_begin = line_end + 1;
+            if (!reply.empty()) {
+                reply.push_back('\n');
+                connected = SendAll(client_socket, reply);
+            }
+        }
+        pending.erase(0, line_begin);
+        if (connected && pending.size() > MAX_REQUEST_LINE_SIZE) {
+            SendAll(client_socket, ErrorReply(std::nullopt, "Request line is too long") + '\n');
+            pending.clear();
+            break;
+        }
+    }
+    // последняя строка без перевода строки
+    if (connected && !pending.empty()) {
+        std::string reply = Answer(pending);
+        if (!reply.empty()) {
+            reply.push_back('\n');
+            SendAll(client_socket, reply);
+        }
+    }
+
+    std::lock_guard lock(clients_mutex_);
+    for (Client& client : clients_) {
+        if (client.socket == client_socket && !client.finished) {
+            client.finished = true;
+            break;
+        }
+    }
+    close(client_socket);
+}
+
+void Server::JoinFinishedClients() {
+    std::vector<std::thread> finished;
+    {
+        std::lock_guard lock(clients_mutex_);
+        auto unfinished_end = std::partition(clients_.begin(), clients_.end(), [](const Client& client) {
+            return !client.finished;
+        });
+        for (auto it = unfinished_end; it != clients_.end(); ++it) {
+            finished.push_back(std::move(it->thread));
+        }
+        clients_.erase(unfinished_end, clients_.end());
+    }
+    for (std::thread& thread : finished) {
+        thread.join();
+    }
+}
+
+void Server::StopClients() {
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard lock(clients_mutex_);
+        for (Client& client : clients_) {
+            if (!client.finished) {
+                shutdown(client.socket, SHUT_RDWR);
+            }
+            threads.push_back(std::move(client.thread));
+        }
+        clients_.clear();
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+} //namespace server
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "json_reader.h"
+#include "reply_cache.h"
+#include "transport_catalogue.h"
+
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace server {
+
+// Загруженная база: справочник и JSONReader, который отвечает на запросы. После загрузки только читается
+class LoadedBase {
+public:
+    // config - входные данные как у process_requests: нужны serialization_settings, stat_requests игнорируются
+    // reply_cache_size - сколько ответов держит кэш, 0 - без кэша
+    LoadedBase(const std::filesystem::path& config, size_t reply_cache_size);
+
+    LoadedBase(const LoadedBase&) = delete;
+    LoadedBase& operator=(const LoadedBase&) = delete;
+
+    void AnswerStatRequest(json::Writer& writer, const json::arena::Node& request);
+    // ответы этой базы; после перезагрузки кэш начинается заново
+    ReplyCache& GetReplyCache();
+
+private:
+    tr_cat::TransportCatalogue transport_catalogue_;
+    JSONReader reader_{ transport_catalogue_ };
+    ReplyCache reply_cache_;
+};
+
+// Режим serve: база загружается один раз, запросы приходят построчно, по одному JSON-словарю
+// в строке, с той же семантикой Stop/Bus/Route/RouteMatrix/Isochrone/Map, что и stat_requests. Ответ - тоже одна строка.
+// Запрос {"id": N, "type": "Reload"} загружает базу заново по конфигурации из --config
+// и подменяет её целиком: запросы, начатые раньше, дорабатывают со старой базой.
+// Файл базы для перезагрузки лучше записывать под другим именем и переименовывать поверх старого,
+// чтобы не менять отображённый в память файл формата mapped.
+// Ответы на Route без departure_time и на Bus кэшируются по остановкам и имени автобуса,
+// {"id": N, "type": "CacheStats"} возвращает ёмкость и заполнение кэша и счётчики попаданий, промахов и вытеснений
+class Server {
+public:
+    static constexpr size_t DEFAULT_REPLY_CACHE_SIZE = 10000;
+    // больше клиентов сокет одновременно не обслуживает: лишним отвечает ошибкой и отключает
+    static constexpr size_t MAX_CLIENTS = 64;
+
+    explicit Server(std::filesystem::path config, size_t reply_cache_size = DEFAULT_REPLY_CACHE_SIZE);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    // ответ на одну строку протокола без перевода строки; на пустую строку - пустой ответ, его не отправляют
+    std::string Answer(std::string_view line);
+
+    // отвечает на строки из input до его конца
+    void ServeStream(std::istream& input, std::ostream& output);
+    // слушает Unix-сокет socket_path, каждый клиент обслуживается в своём потоке, одновременно - не больше
+    // MAX_CLIENTS. Клиент сверх них или приславший строку длиннее 16 МиБ получает ответ с ошибкой и отключается. Возвращает
+    // управление только при ошибке сокета, которую бросает как std::system_error
+    void ServeSocket(const std::filesystem::path& socket_path);
+
+    // загружает базу по конфигурации заново и подменяет текущую; при ошибке остаётся прежняя
+    void Reload();
+
+private:
+    struct Client {
+        std::thread thread;
+        int socket = -1;
+        bool finished = false;
+    };
+
+    std::filesystem::path config_;
+    size_t reply_cache_size_ = DEFAULT_REPLY_CACHE_SIZE;
+    std::shared_ptr<LoadedBase> base_; //только через std::atomic_load/atomic_store
+    std::mutex reload_mutex_; //перезагрузки идут по одной
+    std::mutex clients_mutex_;
+    std::vector<Client> clients_;
+
+    void ReplaceBase(const std::filesystem::path& config);
+    std::string AnswerReload(const json::arena::Node& request);
+    std::string AnswerCacheStats(const json::arena::Node& request);
+    void ServeClient(int client_socket);
+    // ждёт потоки отключившихся клиентов
+    void JoinFinishedClients();
+    // отключает всех клиентов и ждёт их потоки
+    void StopClients();
+};
+
+} //namespace server
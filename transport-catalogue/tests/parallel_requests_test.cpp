@@ -0,0 +1,172 @@
+// Ответы process_requests с --threads=N должны совпадать с последовательными побайтно:
+// тот же порядок и те же числа при любом числе потоков и при повторных запусках.
+// Город и запросы генерируются с фиксированным зерном, запросов больше нескольких кусков по 256
+#include "json_reader.h"
+#include "transport_catalogue.h"
+
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+const int STOP_COUNT = 80;
+const int BUS_COUNT = 40;
+const int REQUEST_COUNT = 2000;
+
+std::string StopName(int i) {
+    return "\"Stop "s + std::to_string(i) + '"';
+}
+
+std::string BusName(int i) {
+    return "\"Bus "s + std::to_string(i) + '"';
+}
+
+std::string SerializationSettings(const std::filesystem::path& file) {
+    return "\"serialization_settings\": {\"file\": \""s + file.string() + "\"}"s;
+}
+
+std::string MakeBaseInput(const std::filesystem::path& file, std::mt19937& random) {
+    std::uniform_real_distribution<double> latitude(55.5, 55.9);
+    std::uniform_real_distribution<double> longitude(37.3, 37.9);
+    std::uniform_int_distribution<int> distance(300, 5000);
+    std::uniform_int_distribution<int> stop(0, STOP_COUNT - 1);
+    std::uniform_int_distribution<int> route_size(4, 14);
+
+    std::ostringstream input;
+    input.precision(9);
+    input << "{" << SerializationSettings(file) << ",\n"
+        << "\"routing_settings\": {\"bus_velocity\": 40, \"bus_wait_time\": 6},\n"
+        << "\"render_settings\": {\"width\": 1200, \"height\": 800, \"padding\": 50, \"line_width\": 14,"
+           " \"stop_radius\": 5, \"bus_label_font_size\": 20, \"bus_label_offset\": [7, 15],"
+           " \"stop_label_font_size\": 18, \"stop_label_offset\": [7, -3],"
+           " \"underlayer_color\": [255, 255, 255, 0.85], \"underlayer_width\": 3,"
+           " \"color_palette\": [\"green\", [255, 160, 0], \"red\"]},\n"
+        << "\"base_requests\": [\n";
+    for (int i = 0; i < STOP_COUNT; ++i) {
+        input << "{\"type\": \"Stop\", \"name\": " << StopName(i) << ", \"latitude\": " << latitude(random)
+            << ", \"longitude\": " << longitude(random) << ", \"road_distances\": {";
+        // у последней остановки нет соседа, она остаётся без автобусов
+        if (i + 1 < STOP_COUNT) {
+            input << StopName(i + 1) << ": " << distance(random) << ", " << StopName(stop(random)) << ": " << distance(random);
+        }
+        input << "}},\n";
+    }
+    for (int i = 0; i < BUS_COUNT; ++i) {
+        const int size = route_size(random);
+        const int first = stop(random) % (STOP_COUNT - size);
+        input << "{\"type\": \"Bus\", \"name\": " << BusName(i) << ", \"is_roundtrip\": " << (i % 3 == 0 ? "true" : "false")
+            << ", \"stops\": [";
+        for (int j = 0; j < size; ++j) {
+            input << (j ? ", " : "") << StopName(first + j);
+        }
+        // кольцевой возвращается теми же перегонами, расстояния для них заданы
+        if (i % 3 == 0) {
+            for (int j = size - 2; j >= 0; --j) {
+                input << ", " << StopName(first + j);
+            }
+        }
+        input << "]}" << (i + 1 < BUS_COUNT ? ",\n" : "\n");
+    }
+    input << "]}\n";
+    return input.str();
+}
+
+// все типы запросов вперемешку, с неизвестными именами
+std::string MakeStatInput(const std::filesystem::path& file, std::mt19937& random) {
+    std::uniform_int_distribution<int> kind(0, 99);
+    std::uniform_int_distribution<int> stop(0, STOP_COUNT + 2);
+    std::uniform_int_distribution<int> bus(0, BUS_COUNT + 1);
+
+    std::ostringstream input;
+    input << "{" << SerializationSettings(file) << ",\n\"stat_requests\": [\n";
+    for (int id = 0; id < REQUEST_COUNT; ++id) {
+        const int k = kind(random);
+        input << "{\"id\": " << id << ", ";
+        if (k < 15) {
+            input << "\"type\": \"Stop\", \"name\": " << StopName(stop(random));
+        }
+        else if (k < 30) {
+            input << "\"type\": \"Bus\", \"name\": " << BusName(bus(random));
+        }
+        else if (k < 85) {
+            input << "\"type\": \"Route\", \"from\": " << StopName(stop(random)) << ", \"to\": " << StopName(stop(random));
+        }
+        else if (k < 92) {
+            input << "\"type\": \"RouteMatrix\", \"from\": [" << StopName(stop(random)) << ", " << StopName(stop(random))
+                << "], \"to\": [" << StopName(stop(random)) << ", " << StopName(stop(random)) << "], \"items\": "
+                << (k % 2 ? "true" : "false");
+        }
+        else if (k < 99) {
+            input << "\"type\": \"Isochrone\", \"from\": " << StopName(stop(random)) << ", \"max_time\": " << k;
+        }
+        else {
+            input << "\"type\": \"Map\"";
+        }
+        input << "}" << (id + 1 < REQUEST_COUNT ? ",\n" : "\n");
+    }
+    input << "]}\n";
+    return input.str();
+}
+
+std::string Process(const std::string& stat_input, size_t threads) {
+    std::istringstream input(stat_input);
+    std::ostringstream output;
+    ProcessRequests(input, output, threads);
+    return output.str();
+}
+
+// ответы идут в порядке запросов: request_id - 0, 1, 2, ...
+bool CheckOrder(const std::string& output) {
+    const json::Document document = json::Load(std::string_view(output));
+    const json::Array& replies = document.GetRoot().AsArray();
+    if (replies.size() != static_cast<size_t>(REQUEST_COUNT)) {
+        std::cerr << "Expected " << REQUEST_COUNT << " replies, got " << replies.size() << '\n';
+        return false;
+    }
+    for (size_t i = 0; i < replies.size(); ++i) {
+        if (replies[i].AsDict().at("request_id"s).AsInt() != static_cast<int>(i)) {
+            std::cerr << "Reply " << i << " has request_id " << replies[i].AsDict().at("request_id"s).AsInt() << '\n';
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CheckFormat(const std::filesystem::path& file) {
+    std::mt19937 random(42);
+    {
+        std::istringstream input(MakeBaseInput(file, random));
+        tr_cat::TransportCatalogue catalogue;
+        JSONReader(catalogue).MakeBase(input);
+    }
+    const std::string stat_input = MakeStatInput(file, random);
+    const std::string sequential = Process(stat_input, 1);
+    bool ok = CheckOrder(sequential);
+    for (size_t threads : { 2, 4, 8, 4, 0 }) {
+        if (Process(stat_input, threads) != sequential) {
+            std::cerr << file.filename().string() << ": --threads=" << threads << " differs from the sequential output\n";
+            ok = false;
+        }
+    }
+    std::filesystem::remove(file);
+    return ok;
+}
+
+} //namespace
+
+int main() {
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::string prefix = "parallel_requests_test_"s + std::to_string(std::random_device{}());
+    bool ok = true;
+    for (const char* extension : { ".db", ".mmap" }) {
+        ok = CheckFormat(dir / (prefix + extension)) && ok;
+    }
+    std::cout << (ok ? "OK" : "FAILED") << '\n';
+    return ok ? 0 : 1;
+}
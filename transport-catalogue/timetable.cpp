@@ -0,0 +1,236 @@
+#include "timetable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+const int M_PER_KM = 1000;
+const int MIN_PER_HOUR = 60;
+// время рейса из суммы перегонов может чуть разойтись с отправлением по расписанию
+const double TIME_EPSILON = 1e-9;
+const double NO_ARRIVAL = std::numeric_limits<double>::infinity();
+
+// скорость на перегоне leg хранимого маршрута; у некольцевого обратная половина идёт по перегонам запроса с конца
+double LegVelocity(const Bus& bus, const BusSchedule* schedule, double bus_velocity, size_t leg) {
+	if (!schedule || schedule->velocities.empty()) {
+		return bus_velocity;
+	}
+	if (bus.is_round || leg + 1 < bus.half_route.size()) {
+		return schedule->velocities.at(leg);
+	}
+	return schedule->velocities.at(2 * (bus.half_route.size() - 1) - leg - 1);
+}
+
+} //namespace
+
+Timetable::Timetable(const tr_cat::TransportCatalogue& catalogue, double bus_wait_time, Data data)
+	: bus_wait_time_(bus_wait_time)
+	, data_(std::move(data)) {
+	if (data_.offsets.size() != data_.stops.size()) {
+		throw std::invalid_argument("Timetable offsets don't match its stops");
+	}
+	for (StopId stop_id : data_.stops) {
+		if (stop_id >= static_cast<size_t>(catalogue.CountStops())) {
+			throw std::invalid_argument("Timetable doesn't match the catalogue");
+		}
+	}
+	for (const Pattern& pattern : data_.patterns) {
+		// NaN не проходит ни одно сравнение, поэтому время проверяется на конечность отдельно
+		if (pattern.bus_id >= catalogue.CountBuses() || pattern.stop_count == 0
+			|| static_cast<size_t>(pattern.first_stop) + pattern.stop_count > data_.stops.size()
+			|| !std::isfinite(pattern.headway) || !std::isfinite(pattern.first_departure)
+			|| !std::isfinite(pattern.last_departure)
+			|| pattern.headway < 0. || pattern.first_departure > pattern.last_departure) {
+			throw std::invalid_argument("Timetable doesn't match the catalogue");
+		}
+		// обратный ход в FindRoute кончается, только если время от начала рейса не убывает
+		const auto offsets = data_.offsets.begin() + pattern.first_stop;
+		if (offsets[0] != 0.) {
+			throw std::invalid_argument("Timetable doesn't match the catalogue");
+		}
+		for (uint32_t position = 1; position < pattern.stop_count; ++position) {
+			if (!std::isfinite(offsets[position]) || offsets[position] < offsets[position - 1]) {
+				throw std::invalid_argument("Timetable doesn't match the catalogue");
+			}
+		}
+		// шаблон - участок маршрута своего автобуса
+		const tr_cat::TransportCatalogue::StopIdRange route = catalogue.GetRouteStops(pattern.bus_id);
+		const auto stops = data_.stops.begin() + pattern.first_stop;
+		if (std::search(route.begin(), route.end(), stops, stops + pattern.stop_count) == route.end()) {
+			throw std::invalid_argument("Timetable doesn't match the catalogue");
+		}
+	}
+	BuildStopIndex(catalogue.CountStops());
+}
+
+Timetable Timetable::Build(const tr_cat::TransportCatalogue& catalogue, double bus_wait_time, double bus_velocity,
+	const BusSchedules& schedules) {
+	Data data;
+	for (BusId bus_id : catalogue.GetSortedBusIds()) {
+		const Bus& bus = *catalogue.GetBus(bus_id);
+		if (bus.route.empty()) {
+			continue;
+		}
+		const auto schedule_it = schedules.find(bus_id);
+		const BusSchedule* schedule = schedule_it == schedules.end() ? nullptr : &schedule_it->second;
+		const StopId* stops = catalogue.GetRouteStops(bus_id).begin();
+		const int* legs = catalogue.GetRouteLegDistances(bus_id).begin();
+		// кольцевой маршрут - один шаблон, некольцевой - туда и обратно с общей разворотной остановкой
+		std::vector<std::pair<size_t, size_t>> segments; //[первая остановка, последняя]
+		if (bus.is_round) {
+			segments.push_back({ 0, bus.route.size() - 1 });
+		}
+		else if (!bus.half_route.empty()) {
+			segments.push_back({ 0, bus.half_route.size() - 1 });
+			segments.push_back({ bus.half_route.size() - 1, bus.route.size() - 1 });
+		}
+		for (const auto& [first, last] : segments) {
+			Pattern pattern;
+			pattern.bus_id = bus_id;
+			pattern.first_stop = static_cast<uint32_t>(data.stops.size());
+			pattern.stop_count = static_cast<uint32_t>(last - first + 1);
+			if (schedule) {
+				pattern.headway = schedule->headway;
+				pattern.first_departure = schedule->first_departure;
+				pattern.last_departure = schedule->last_departure;
+			}
+			double offset = 0.;
+			for (size_t i = first; i <= last; ++i) {
+				if (i > first) {
+					offset += (legs[i - 1] * MIN_PER_HOUR) / (LegVelocity(bus, schedule, bus_velocity, i - 1) * M_PER_KM);
+				}
+				data.stops.push_back(stops[i]);
+				data.offsets.push_back(offset);
+			}
+			data.patterns.push_back(pattern);
+		}
+	}
+	return Timetable(catalogue, bus_wait_time, std::move(data));
+}
+
+void Timetable::BuildStopIndex(size_t stop_count) {
+	stop_pattern_begins_.assign(stop_count + 1, 0);
+	for (StopId stop_id : data_.stops) {
+		++stop_pattern_begins_[stop_id + 1];
+	}
+	for (size_t i = 1; i <= stop_count; ++i) {
+		stop_pattern_begins_[i] += stop_pattern_begins_[i - 1];
+	}
+	stop_patterns_.resize(data_.stops.size());
+	std::vector<uint32_t> next(stop_pattern_begins_.begin(), stop_pattern_begins_.end() - 1);
+	for (uint32_t pattern_id = 0; pattern_id < data_.patterns.size(); ++pattern_id) {
+		const Pattern& pattern = data_.patterns[pattern_id];
+		for (uint32_t position = 0; position < pattern.stop_count; ++position) {
+			stop_patterns_[next[data_.stops[pattern.first_stop + position]]++] = PatternStop{ pattern_id, position };
+		}
+	}
+}
+
+std::optional<double> Timetable::EarliestTrip(const Pattern& pattern, uint32_t position, double arrival) const {
+	const double offset = data_.offsets[pattern.first_stop + position];
+	if (pattern.headway == 0.) {
+		return arrival + bus_wait_time_ - offset;
+	}
+	const double trips = std::max(std::ceil((arrival - offset - pattern.first_departure) / pattern.headway - TIME_EPSILON), 0.);
+	const double start = pattern.first_departure + trips * pattern.headway;
+	if (start > pattern.last_departure + TIME_EPSILON) {
+		return std::nullopt;
+	}
+	return start;
+}
+
+std::optional<std::vector<Timetable::Leg>> Timetable::FindRoute(StopId from, StopId to, double departure) const {
+	const size_t stop_count = stop_pattern_begins_.size() - 1;
+	if (from >= stop_count || to >= stop_count) {
+		return std::nullopt;
+	}
+	// лучшее прибытие на остановку и рейс, которым на неё приехали
+	struct Label {
+		double arrival = NO_ARRIVAL;
+		uint32_t pattern = NO_PATTERN;
+		uint32_t board_position = 0;
+		uint32_t alight_position = 0;
+		double trip_start = 0.;
+	};
+	std::vector<Label> labels(stop_count);
+	labels[from].arrival = departure;
+
+	std::vector<StopId> marked{ from };
+	std::vector<bool> is_marked(stop_count);
+	const uint32_t no_position = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> scan_from(data_.patterns.size(), no_position); //первая улучшенная остановка шаблона
+	std::vector<uint32_t> queued;
+	while (!marked.empty()) {
+		for (StopId stop_id : marked) {
+			is_marked[stop_id] = false;
+			for (uint32_t i = stop_pattern_begins_[stop_id]; i < stop_pattern_begins_[stop_id + 1]; ++i) {
+				const PatternStop& pattern_stop = stop_patterns_[i];
+				if (scan_from[pattern_stop.pattern] == no_position) {
+					queued.push_back(pattern_stop.pattern);
+				}
+				scan_from[pattern_stop.pattern] = std::min(scan_from[pattern_stop.pattern], pattern_stop.position);
+			}
+		}
+		marked.clear();
+
+		for (uint32_t pattern_id : queued) {
+			const Pattern& pattern = data_.patterns[pattern_id];
+			std::optional<double> trip_start;
+			uint32_t board_position = 0;
+			for (uint32_t position = scan_from[pattern_id]; position < pattern.stop_count; ++position) {
+				const StopId stop_id = data_.stops[pattern.first_stop + position];
+				Label& label = labels[stop_id];
+				if (trip_start) {
+					const double arrival = *trip_start + data_.offsets[pattern.first_stop + position];
+					if (arrival < label.arrival && arrival < labels[to].arrival) {
+						label = Label{ arrival, pattern_id, board_position, position, *trip_start };
+						if (!is_marked[stop_id]) {
+							is_marked[stop_id] = true;
+							marked.push_back(stop_id);
+						}
+					}
+				}
+				if (label.arrival == NO_ARRIVAL || position + 1 == pattern.stop_count) {
+					continue;
+				}
+				// на этой остановке можно успеть на более ранний рейс
+				const std::optional<double> earlier_trip = EarliestTrip(pattern, position, label.arrival);
+				if (earlier_trip && (!trip_start || *earlier_trip < *trip_start)) {
+					trip_start = earlier_trip;
+					board_position = position;
+				}
+			}
+			scan_from[pattern_id] = no_position;
+		}
+		queued.clear();
+	}
+
+	if (labels[to].arrival == NO_ARRIVAL) {
+		return std::nullopt;
+	}
+	// остановки пути прибывают всё раньше от to к from, поэтому цепочка рейсов конечна
+	std::vector<Leg> legs;
+	for (StopId stop_id = to; stop_id != from;) {
+		const Label& label = labels[stop_id];
+		const Pattern& pattern = data_.patterns[label.pattern];
+		const StopId board_stop = data_.stops[pattern.first_stop + label.board_position];
+		const double board_time = label.trip_start + data_.offsets[pattern.first_stop + label.board_position];
+		legs.push_back(Leg{ board_stop, pattern.bus_id, board_time - labels[board_stop].arrival,
+			label.arrival - board_time, label.alight_position - label.board_position });
+		stop_id = board_stop;
+	}
+	std::reverse(legs.begin(), legs.end());
+	return legs;
+}
+
+const Timetable::Data& Timetable::GetData() const {
+	return data_;
+}
+
+size_t Timetable::GetMemoryUsage() const {
+	return data_.patterns.capacity() * sizeof(Pattern) + data_.stops.capacity() * sizeof(StopId)
+		+ data_.offsets.capacity() * sizeof(double) + stop_pattern_begins_.capacity() * sizeof(uint32_t)
+		+ stop_patterns_.capacity() * sizeof(PatternStop);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "domain.h"
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Расписание автобуса из base_requests. Рейсы отправляются с конечных каждые headway минут
+// с first_departure до last_departure включительно (минуты от полуночи), без стоянок на остановках.
+// velocities - скорости (км/ч) по перегонам между остановками в порядке запроса Bus,
+// у некольцевого маршрута обратно те же в обратном порядке; пустой - bus_velocity из routing_settings
+struct BusSchedule {
+	double headway = 0.;
+	double first_departure = 0.;
+	double last_departure = 0.;
+	std::vector<double> velocities;
+};
+
+using BusSchedules = std::unordered_map<BusId, BusSchedule>;
+
+// Компактное расписание для поиска самого раннего прибытия ко времени отправления.
+// Участок маршрута в одну сторону - шаблон: его остановки и время от отправления рейса с первой
+// из них. Рейсы шаблона отличаются только временем отправления, поэтому хранятся не рейсы, а интервал.
+// Автобусы без расписания ходят всегда, их ждут bus_wait_time, как при маршрутизации по графу
+class Timetable {
+public:
+	static constexpr uint32_t NO_PATTERN = std::numeric_limits<uint32_t>::max();
+
+	struct Pattern {
+		uint32_t bus_id = 0;
+		uint32_t first_stop = 0; //индекс первой остановки в stops и offsets
+		uint32_t stop_count = 0;
+		double headway = 0.; //0 - автобус без расписания
+		double first_departure = 0.;
+		double last_departure = 0.;
+	};
+
+	struct Data {
+		std::vector<Pattern> patterns;
+		std::vector<StopId> stops;
+		std::vector<double> offsets; //минуты от отправления рейса с первой остановки шаблона
+	};
+
+	// ожидание на остановке board_stop и поездка на автобусе bus через span_count перегонов
+	struct Leg {
+		StopId board_stop = 0;
+		BusId bus = 0;
+		double wait_time = 0.;
+		double ride_time = 0.;
+		uint32_t span_count = 0;
+	};
+
+	Timetable() = default;
+	// std::invalid_argument, если data не подходит к справочнику
+	Timetable(const tr_cat::TransportCatalogue& catalogue, double bus_wait_time, Data data);
+
+	//phase make_base: шаблоны по автобусам в порядке имён, как рёбра графа
+	static Timetable Build(const tr_cat::TransportCatalogue& catalogue, double bus_wait_time, double bus_velocity,
+		const BusSchedules& schedules);
+
+	// Самое раннее прибытие в to при отправлении из from в момент departure (минуты от полуночи).
+	// RAPTOR: каждый раунд просматривает шаблоны через остановки, улучшенные в прошлом раунде,
+	// то есть добавляет пересадку. nullopt, если до to не добраться
+	std::optional<std::vector<Leg>> FindRoute(StopId from, StopId to, double departure) const;
+
+	const Data& GetData() const;
+	size_t GetMemoryUsage() const;
+
+private:
+	struct PatternStop {
+		uint32_t pattern = 0;
+		uint32_t position = 0;
+	};
+
+	double bus_wait_time_ = 0.;
+	Data data_;
+	// шаблоны через остановку: stop_patterns_[stop_pattern_begins_[id]..stop_pattern_begins_[id + 1])
+	std::vector<uint32_t> stop_pattern_begins_;
+	std::vector<PatternStop> stop_patterns_;
+
+	void BuildStopIndex(size_t stop_count);
+	// отправление с первой остановки самого раннего рейса, на который можно сесть на остановке position,
+	// прибыв туда в arrival; nullopt, если рейсов больше нет
+	std::optional<double> EarliestTrip(const Pattern& pattern, uint32_t position, double arrival) const;
+};
@@ -1,88 +1,402 @@
 #include "transport_catalogue.h"
 
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+
 namespace tr_cat {
-namespace detail {
-    
-size_t PairPtrHasher::operator()(const std::pair<Stop*, Stop*> p) const {
-	size_t h1 = hasher_(p.first);
-	size_t h2 = hasher_(p.second);
-	return h1 + 37 * h2;
-}
-    
-} //namespace detail
 
 Stop* TransportCatalogue::AddStop(const Stop&& stop) {
-	stops_.emplace_back(stop);
-	stops_index_[stops_.back().name] = &stops_.back();
-	stops_with_buses_[&stops_.back()];
-	Stop* to_return = &stops_.back();
+	Stop* to_return = nullptr;
+	if (const std::optional<StopId> id = stop_name_index_.Find(stop.name)) {
+		to_return = &stops_[*id];
+		to_return->place = stop.place;
+		stop_coordinates_[*id] = stop.place;
+		bus_stats_stored_ = false;
+	}
+	else {
+		stops_.emplace_back(stop);
+		to_return = &stops_.back();
+		to_return->id = static_cast<StopId>(stops_.size() - 1);
+		stop_names_.push_back(to_return->name);
+		stop_coordinates_.push_back(to_return->place);
+		stop_name_index_.Add(to_return->id);
+	}
+	indexes_ready_ = false;
+	++version_;
 	return to_return;
 }
 
 Bus* TransportCatalogue::AddBus(const Bus&& bus) {
-	buses_.emplace_back(bus);
-	buses_index_[buses_.back().name] = &buses_.back();
-	for (const auto stop : bus.unique_stops) {
-		stops_with_buses_[stop].insert(&buses_.back());
+	std::vector<StopId> route;
+	route.reserve(bus.route.size());
+	for (const Stop* stop : bus.route) {
+		route.push_back(GetStopId(stop));
+	}
+
+	Bus* to_return = nullptr;
+	if (const std::optional<BusId> id = bus_name_index_.Find(bus.name)) {
+		to_return = &buses_[*id];
+		to_return->route = bus.route;
+		to_return->is_round = bus.is_round;
+		to_return->half_route = bus.half_route;
+		// маршрут заменяется на месте, смещения следующих маршрутов сдвигаются
+		const auto old_begin = route_stops_.begin() + route_offsets_[*id];
+		const auto old_end = route_stops_.begin() + route_offsets_[*id + 1];
+		const int64_t shift = static_cast<int64_t>(route.size()) - (old_end - old_begin);
+		route_stops_.insert(route_stops_.erase(old_begin, old_end), route.begin(), route.end());
+		for (size_t i = *id + 1; i < route_offsets_.size(); ++i) {
+			route_offsets_[i] = static_cast<uint32_t>(route_offsets_[i] + shift);
+		}
+	}
+	else {
+		buses_.emplace_back(bus);
+		to_return = &buses_.back();
+		to_return->id = static_cast<BusId>(buses_.size() - 1);
+		bus_names_.push_back(to_return->name);
+		bus_name_index_.Add(to_return->id);
+		route_stops_.insert(route_stops_.end(), route.begin(), route.end());
+		route_offsets_.push_back(static_cast<uint32_t>(route_stops_.size()));
+		unique_stop_counts_.push_back(0);
 	}
-	return &buses_.back();
+
+	std::sort(route.begin(), route.end());
+	unique_stop_counts_[to_return->id] = static_cast<uint32_t>(std::unique(route.begin(), route.end()) - route.begin());
+	indexes_ready_ = false;
+	bus_stats_stored_ = false;
+	++version_;
+	return to_return;
 }
 
 std::optional<Bus*> TransportCatalogue::FindBus(const std::string_view name) const {
-	if (!buses_index_.count(name)) {
+	const std::optional<BusId> id = bus_name_index_.Find(name);
+	if (!id) {
 		return std::nullopt;
 	}
-	else {
-		return buses_index_.at(name);
-	}
+	return GetBus(*id);
 }
 
 std::optional<Stop*> TransportCatalogue::FindStop(const std::string_view name) const {
-	if (!stops_index_.count(name)) {
+	const std::optional<StopId> id = stop_name_index_.Find(name);
+	if (!id) {
 		return std::nullopt;
 	}
-	else {
-		return stops_index_.at(name);
+	return GetStop(*id);
+}
+
+void TransportCatalogue::SetStopNamesPerfectHash(PerfectHash perfect_hash) {
+	stop_name_index_.SetPerfectHash(std::move(perfect_hash));
+}
+
+void TransportCatalogue::SetBusNamesPerfectHash(PerfectHash perfect_hash) {
+	bus_name_index_.SetPerfectHash(std::move(perfect_hash));
+}
+
+Stop* TransportCatalogue::GetStop(StopId id) const {
+	return const_cast<Stop*>(&stops_.at(id));
+}
+
+Bus* TransportCatalogue::GetBus(BusId id) const {
+	return const_cast<Bus*>(&buses_.at(id));
+}
+
+std::string_view TransportCatalogue::GetStopName(StopId id) const {
+	return stop_names_.at(id);
+}
+
+geo::Coordinates TransportCatalogue::GetStopCoordinates(StopId id) const {
+	return stop_coordinates_.at(id);
+}
+
+std::string_view TransportCatalogue::GetBusName(BusId id) const {
+	return bus_names_.at(id);
+}
+
+TransportCatalogue::StopIdRange TransportCatalogue::GetRouteStops(BusId id) const {
+	const StopId* stops = route_stops_.data();
+	return { stops + route_offsets_.at(id), stops + route_offsets_.at(id + 1) };
+}
+
+size_t TransportCatalogue::GetUniqueStopCount(BusId id) const {
+	return unique_stop_counts_.at(id);
+}
+
+TransportCatalogue::BusIdRange TransportCatalogue::GetBusesForStop(StopId id) const {
+	EnsureIndexes();
+	const BusId* buses = stop_bus_ids_.data();
+	return { buses + stop_bus_offsets_.at(id), buses + stop_bus_offsets_.at(id + 1) };
+}
+
+TransportCatalogue::NameRange TransportCatalogue::GetBusNamesForStop(StopId id) const {
+	EnsureIndexes();
+	const std::string_view* names = stop_bus_names_.data();
+	return { names + stop_bus_offsets_.at(id), names + stop_bus_offsets_.at(id + 1) };
+}
+
+TransportCatalogue::StopIdRange TransportCatalogue::GetSortedStopIds() const {
+	EnsureIndexes();
+	return { sorted_stop_ids_.data(), sorted_stop_ids_.data() + sorted_stop_ids_.size() };
+}
+
+TransportCatalogue::BusIdRange TransportCatalogue::GetSortedBusIds() const {
+	EnsureIndexes();
+	return { sorted_bus_ids_.data(), sorted_bus_ids_.data() + sorted_bus_ids_.size() };
+}
+
+void TransportCatalogue::EnsureIndexes() const {
+	if (!indexes_ready_.load(std::memory_order_acquire)) {
+		std::lock_guard lock(indexes_mutex_);
+		if (!indexes_ready_.load(std::memory_order_relaxed)) {
+			BuildSortedIds();
+			BuildStopBusesIndex();
+			BuildRoadDistancesIndex();
+			BuildRouteLegsIndex();
+			BuildBusStats();
+			indexes_ready_.store(true, std::memory_order_release);
+		}
+	}
+}
+
+void TransportCatalogue::BuildStopBusesIndex() const {
+	// два прохода: число автобусов у каждой остановки, затем раскладка; повторы остановки
+	// в маршруте отсекаются по последнему записавшему её автобусу. Автобусы обходятся
+	// по возрастанию имён, так что у каждой остановки они сразу оказываются в этом порядке
+	const BusId NO_BUS = static_cast<BusId>(-1);
+	std::vector<BusId> last_bus(stops_.size(), NO_BUS);
+	std::vector<uint32_t> offsets(stops_.size() + 1, 0);
+	for (BusId bus : sorted_bus_ids_) {
+		for (StopId stop : GetRouteStops(bus)) {
+			if (last_bus[stop] != bus) {
+				last_bus[stop] = bus;
+				++offsets[stop + 1];
+			}
+		}
+	}
+	for (size_t i = 1; i < offsets.size(); ++i) {
+		offsets[i] += offsets[i - 1];
 	}
+
+	std::vector<BusId> ids(offsets.back());
+	std::vector<uint32_t> positions(offsets.begin(), offsets.end() - 1);
+	std::fill(last_bus.begin(), last_bus.end(), NO_BUS);
+	for (BusId bus : sorted_bus_ids_) {
+		for (StopId stop : GetRouteStops(bus)) {
+			if (last_bus[stop] != bus) {
+				last_bus[stop] = bus;
+				ids[positions[stop]++] = bus;
+			}
+		}
+	}
+	stop_bus_names_.resize(ids.size());
+	for (size_t i = 0; i < ids.size(); ++i) {
+		stop_bus_names_[i] = bus_names_[ids[i]];
+	}
+	stop_bus_offsets_ = std::move(offsets);
+	stop_bus_ids_ = std::move(ids);
 }
 
-const std::set<Bus*> TransportCatalogue::GetBusesForStop(Stop* stop) const {
-	return stops_with_buses_.at(stop);
+void TransportCatalogue::BuildSortedIds() const {
+	auto sort_by_name = [](const std::vector<std::string_view>& names, std::vector<uint32_t>& ids) {
+		ids.resize(names.size());
+		for (uint32_t id = 0; id < ids.size(); ++id) {
+			ids[id] = id;
+		}
+		// база пишется по именам, так что после загрузки сортировать обычно нечего
+		auto by_name = [&names](uint32_t lhs, uint32_t rhs) {
+			return names[lhs] < names[rhs];
+		};
+		if (!std::is_sorted(ids.begin(), ids.end(), by_name)) {
+			std::sort(ids.begin(), ids.end(), by_name);
+		}
+	};
+	sort_by_name(stop_names_, sorted_stop_ids_);
+	sort_by_name(bus_names_, sorted_bus_ids_);
 }
 
-void TransportCatalogue::AddDistances(std::pair<std::pair<Stop*, Stop*>, int>&& p) {
-	distances_[p.first] = p.second;
+void TransportCatalogue::BuildRoadDistancesIndex() const {
+	// кандидаты: каждое заданное расстояние и оно же в обратную сторону. После сортировки первым
+	// для пары идёт заданное последним в прямую сторону, а обратное - только если прямого нет
+	struct Candidate {
+		StopId from;
+		StopId to;
+		bool reverse;
+		uint32_t order;
+	};
+	std::vector<Candidate> candidates;
+	candidates.reserve(distances_.size() * 2);
+	for (uint32_t i = 0; i < distances_.size(); ++i) {
+		candidates.push_back({ distances_[i].from, distances_[i].to, false, i });
+		candidates.push_back({ distances_[i].to, distances_[i].from, true, i });
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& lhs, const Candidate& rhs) {
+		if (lhs.from != rhs.from || lhs.to != rhs.to || lhs.reverse != rhs.reverse) {
+			return std::tie(lhs.from, lhs.to, lhs.reverse) < std::tie(rhs.from, rhs.to, rhs.reverse);
+		}
+		return lhs.order > rhs.order;
+	});
+	candidates.erase(std::unique(candidates.begin(), candidates.end(), [](const Candidate& lhs, const Candidate& rhs) {
+		return lhs.from == rhs.from && lhs.to == rhs.to;
+	}), candidates.end());
+
+	road_offsets_.assign(stops_.size() + 1, 0);
+	road_neighbours_.resize(candidates.size());
+	road_lengths_.resize(candidates.size());
+	for (size_t i = 0; i < candidates.size(); ++i) {
+		++road_offsets_[candidates[i].from + 1];
+		road_neighbours_[i] = candidates[i].to;
+		road_lengths_[i] = distances_[candidates[i].order].distance;
+	}
+	for (size_t i = 1; i < road_offsets_.size(); ++i) {
+		road_offsets_[i] += road_offsets_[i - 1];
+	}
 }
 
-int TransportCatalogue::GetDistanceBtwStops(Stop* stop1, Stop* stop2) const {
-	std::pair<Stop*, Stop*> p = std::make_pair(stop1, stop2);
-	if (distances_.count(p)) {
-		return distances_.at(p);
+void TransportCatalogue::BuildRouteLegsIndex() const {
+	route_leg_distances_.assign(route_stops_.size(), 0);
+	route_legs_complete_.assign(buses_.size(), true);
+	for (BusId bus = 0; bus < buses_.size(); ++bus) {
+		for (uint32_t i = route_offsets_[bus]; i + 1 < route_offsets_[bus + 1]; ++i) {
+			const int distance = FindDistance(route_stops_[i], route_stops_[i + 1]);
+			if (distance == NO_DISTANCE) {
+				route_legs_complete_[bus] = false;
+			}
+			route_leg_distances_[i] = distance;
+		}
+	}
+}
+
+int TransportCatalogue::FindDistance(StopId from, StopId to) const {
+	const StopId* begin = road_neighbours_.data() + road_offsets_.at(from);
+	const StopId* end = road_neighbours_.data() + road_offsets_.at(from + 1);
+	// у большинства остановок несколько соседей, и просмотр подряд быстрее двоичного поиска
+	const ptrdiff_t LINEAR_SCAN_LIMIT = 16;
+	const StopId* it = begin;
+	if (end - begin <= LINEAR_SCAN_LIMIT) {
+		while (it != end && *it < to) {
+			++it;
+		}
 	}
 	else {
-		p = std::make_pair(stop2, stop1);
-		return distances_.at(p);
+		it = std::lower_bound(begin, end, to);
 	}
+	if (it == end || *it != to) {
+		return NO_DISTANCE;
+	}
+	return road_lengths_[it - road_neighbours_.data()];
 }
 
-const std::map<std::string_view, Bus*>& TransportCatalogue::GetAllBuses() const {
-	return buses_index_;
+StopId TransportCatalogue::GetStopId(const Stop* stop) const {
+	if (stop == nullptr || stop->id >= stops_.size() || &stops_[stop->id] != stop) {
+		throw std::invalid_argument("Stop is not in the catalogue");
+	}
+	return stop->id;
 }
 
-const std::map<Stop*, std::set<Bus*>>& TransportCatalogue::GetStopsWithBuses() const {
-	return stops_with_buses_;
+void TransportCatalogue::AddDistances(std::pair<std::pair<Stop*, Stop*>, int>&& p) {
+	distances_.push_back(RoadDistance{ GetStopId(p.first.first), GetStopId(p.first.second), p.second });
+	indexes_ready_ = false;
+	bus_stats_stored_ = false;
+	++version_;
 }
 
-const std::map<std::string_view, Stop*>& TransportCatalogue::GetStopsIndex() const {
-	return stops_index_;
+int TransportCatalogue::GetDistanceBtwStops(Stop* stop1, Stop* stop2) const {
+	return GetDistance(GetStopId(stop1), GetStopId(stop2));
+}
+
+int TransportCatalogue::GetDistance(StopId from, StopId to) const {
+	EnsureIndexes();
+	const int distance = FindDistance(from, to);
+	if (distance == NO_DISTANCE) {
+		throw std::out_of_range("No road distance between stops");
+	}
+	return distance;
+}
+
+TransportCatalogue::DistanceRange TransportCatalogue::GetRouteLegDistances(BusId id) const {
+	EnsureIndexes();
+	CheckRouteLegs(id);
+	const uint32_t begin = route_offsets_[id];
+	const uint32_t stop_count = route_offsets_[id + 1] - begin;
+	const uint32_t leg_count = stop_count == 0 ? 0 : stop_count - 1;
+	const int* legs = route_leg_distances_.data() + begin;
+	return { legs, legs + leg_count };
 }
 
 int TransportCatalogue::CountStops() const {
 	return stops_.size();
 }
 
-const std::unordered_map<std::pair<Stop*, Stop*>, int, detail::PairPtrHasher>& TransportCatalogue::GetDistances() const {
+size_t TransportCatalogue::CountBuses() const {
+	return buses_.size();
+}
+
+uint64_t TransportCatalogue::GetVersion() const {
+	return version_;
+}
+
+const std::vector<RoadDistance>& TransportCatalogue::GetDistances() const {
 	return distances_;
 }
 
+const BusStat& TransportCatalogue::GetBusStat(BusId id) const {
+	EnsureIndexes();
+	CheckRouteLegs(id);
+	return bus_stats_[id];
+}
+
+BusStat TransportCatalogue::ComputeBusStat(BusId id) const {
+	EnsureIndexes();
+	CheckRouteLegs(id);
+	return CalculateBusStat(id);
+}
+
+const std::vector<BusStat>& TransportCatalogue::GetBusStats() const {
+	EnsureIndexes();
+	return bus_stats_;
+}
+
+void TransportCatalogue::SetBusStats(std::vector<BusStat> bus_stats) {
+	if (bus_stats.size() != buses_.size()) {
+		throw std::invalid_argument("Bus stats do not match buses");
+	}
+	bus_stats_ = std::move(bus_stats);
+	bus_stats_stored_ = true;
+}
+
+bool TransportCatalogue::HasStoredBusStats() const {
+	return bus_stats_stored_;
+}
+
+void TransportCatalogue::BuildBusStats() const {
+	if (bus_stats_stored_) {
+		return;
+	}
+	bus_stats_.assign(buses_.size(), BusStat{});
+	for (BusId bus = 0; bus < buses_.size(); ++bus) {
+		if (route_legs_complete_[bus]) {
+			bus_stats_[bus] = CalculateBusStat(bus);
+		}
+	}
+}
+
+BusStat TransportCatalogue::CalculateBusStat(BusId id) const {
+	BusStat result;
+	const uint32_t begin = route_offsets_[id];
+	const uint32_t end = route_offsets_[id + 1];
+	result.stop_count = static_cast<int>(end - begin);
+	for (uint32_t i = begin; i + 1 < end; ++i) {
+		result.geo_length += ComputeDistance(stop_coordinates_[route_stops_[i]], stop_coordinates_[route_stops_[i + 1]]);
+		result.route_length += route_leg_distances_[i];
+	}
+	result.curvature = result.route_length / result.geo_length;
+	result.unique_stop_count = static_cast<int>(unique_stop_counts_[id]);
+	return result;
+}
+
+void TransportCatalogue::CheckRouteLegs(BusId id) const {
+	if (!route_legs_complete_.at(id)) {
+		throw std::out_of_range("No road distance for a leg of bus " + std::string(bus_names_[id]));
+	}
+}
+
 } //namespace tr_cat
\ No newline at end of file
@@ -2,60 +2,153 @@
 
 #include "geo.h"
 #include "domain.h"
+#include "name_index.h"
+#include "ranges.h"
 
+#include <atomic>
 #include <string>
 #include <string_view>
-#include <unordered_set>
-#include <unordered_map>
-#include <map>
-#include <set>
+#include <mutex>
 #include <deque>
 #include <optional>
 #include <vector>
 
 namespace tr_cat {
 
-namespace detail {
-struct PairPtrHasher {
-	size_t operator()(const std::pair<Stop*, Stop*> p) const;
-private:
-	std::hash<const void*> hasher_;
-};
-}//namespace detail
-
+// Остановки и автобусы получают плотные id в порядке добавления. Координаты, имена и маршруты
+// хранятся по id в отдельных векторах, маршруты и списки автобусов остановок - в формате CSR
+// (массив смещений + сплошной массив id). Stop* и Bus* остаются для кода, работающего с указателями.
+// Поиск по имени идёт через хеш-индекс, порядок по именам дают отдельные массивы id.
+// Расстояния по дорогам хранятся списками смежности CSR с соседями по возрастанию id,
+// где обратное направление уже подставлено для пар, заданных только в одну сторону
 class TransportCatalogue {
 public:
+	using StopIdRange = ranges::Range<const StopId*>;
+	using BusIdRange = ranges::Range<const BusId*>;
+	using DistanceRange = ranges::Range<const int*>;
+	using NameRange = ranges::Range<const std::string_view*>;
+
+	// Остановка или автобус с уже известным именем заменяют прежнее определение: id и указатель
+	// остаются прежними, меняются координаты или маршрут, то есть действует последнее определение
 	Stop* AddStop(const Stop&& stop);
 
+	// все остановки маршрута должны быть уже добавлены
 	Bus* AddBus(const Bus&& bus);
 
 	std::optional<Bus*> FindBus(const std::string_view name) const;
 
 	std::optional<Stop*> FindStop(const std::string_view name) const;
 
-	const std::set<Bus*> GetBusesForStop(Stop* stop) const;
+	// идеальные хеш-функции имён из базы, в том же порядке id; сбрасываются добавлением нового имени
+	void SetStopNamesPerfectHash(PerfectHash perfect_hash);
+	void SetBusNamesPerfectHash(PerfectHash perfect_hash);
+
+	Stop* GetStop(StopId id) const;
+
+	Bus* GetBus(BusId id) const;
+
+	std::string_view GetStopName(StopId id) const;
+
+	geo::Coordinates GetStopCoordinates(StopId id) const;
+
+	std::string_view GetBusName(BusId id) const;
+
+	// остановки маршрута в порядке следования, для некольцевого - туда и обратно
+	StopIdRange GetRouteStops(BusId id) const;
 
+	size_t GetUniqueStopCount(BusId id) const;
+
+	// автобусы, проходящие через остановку, по возрастанию имён
+	BusIdRange GetBusesForStop(StopId id) const;
+
+	// имена тех же автобусов подряд, готовые для ответа на запрос Stop
+	NameRange GetBusNamesForStop(StopId id) const;
+
+	// повторно заданная пара заменяет расстояние
 	void AddDistances(std::pair<std::pair<Stop*, Stop*>, int>&& p);
 
 	int GetDistanceBtwStops(Stop* stop1, Stop* stop2) const;
 
-	const std::map<std::string_view, Bus*>& GetAllBuses() const;
+	// расстояние from -> to, а если оно не задано, то to -> from; std::out_of_range, если нет обоих
+	int GetDistance(StopId from, StopId to) const;
 
-	const std::map<Stop*, std::set<Bus*>>& GetStopsWithBuses() const;
+	// расстояния перегонов маршрута: i-е - между i-й и (i+1)-й остановками GetRouteStops(id);
+	// std::out_of_range, если для какого-то перегона расстояние не задано
+	DistanceRange GetRouteLegDistances(BusId id) const;
 
-	const std::map<std::string_view, Stop*>& GetStopsIndex() const;
+	// id по возрастанию имён
+	StopIdRange GetSortedStopIds() const;
+	BusIdRange GetSortedBusIds() const;
 
 	int CountStops() const;
 
-	const std::unordered_map<std::pair<Stop*, Stop*>, int, detail::PairPtrHasher>& GetDistances() const;
+	size_t CountBuses() const;
+
+	// меняется при каждом добавлении: по ней производные от справочника кэши понимают, что устарели
+	uint64_t GetVersion() const;
+
+	// расстояния в том виде и порядке, в котором их добавляли
+	const std::vector<RoadDistance>& GetDistances() const;
+
+	// Статистика маршрута считается один раз для всех автобусов или берётся из базы.
+	// std::out_of_range, если для какого-то перегона расстояние не задано
+	const BusStat& GetBusStat(BusId id) const;
+
+	// пересчёт без сохранённой статистики, для проверки базы
+	BusStat ComputeBusStat(BusId id) const;
+
+	// по id; у маршрутов без расстояний на каком-то перегоне - нули
+	const std::vector<BusStat>& GetBusStats() const;
+
+	// статистика из базы в том же порядке id; сбрасывается добавлением автобуса или расстояния
+	void SetBusStats(std::vector<BusStat> bus_stats);
+	bool HasStoredBusStats() const;
 
 private:
+	static constexpr int NO_DISTANCE = -1;
+
 	std::deque<Stop> stops_;
 	std::deque<Bus> buses_;
-	std::map<std::string_view, Bus*> buses_index_;
-	std::map<std::string_view, Stop*> stops_index_;
-	std::map<Stop*, std::set<Bus*>> stops_with_buses_;
-	std::unordered_map<std::pair<Stop*, Stop*>, int, detail::PairPtrHasher> distances_;
+	std::vector<RoadDistance> distances_;
+	uint64_t version_ = 0;
+
+	std::vector<std::string_view> stop_names_;
+	std::vector<geo::Coordinates> stop_coordinates_;
+	NameIndex stop_name_index_{ stop_names_ };
+
+	std::vector<std::string_view> bus_names_;
+	NameIndex bus_name_index_{ bus_names_ };
+	std::vector<uint32_t> route_offsets_ = { 0 };
+	std::vector<StopId> route_stops_;
+	std::vector<uint32_t> unique_stop_counts_;
+
+	// CSR остановка -> автобусы, порядок по именам, CSR расстояний и перегоны маршрутов строятся
+	// при первом запросе после добавлений; запросы могут идти из нескольких потоков, добавление - нет
+	mutable std::mutex indexes_mutex_;
+	mutable std::atomic<bool> indexes_ready_ = false;
+	mutable std::vector<uint32_t> stop_bus_offsets_;
+	mutable std::vector<BusId> stop_bus_ids_;
+	mutable std::vector<std::string_view> stop_bus_names_; //параллельно stop_bus_ids_
+	mutable std::vector<StopId> sorted_stop_ids_;
+	mutable std::vector<BusId> sorted_bus_ids_;
+	mutable std::vector<uint32_t> road_offsets_;
+	mutable std::vector<StopId> road_neighbours_;
+	mutable std::vector<int> road_lengths_;
+	mutable std::vector<int> route_leg_distances_; //параллельно route_stops_, у последней остановки маршрута 0
+	mutable std::vector<bool> route_legs_complete_;
+	mutable std::vector<BusStat> bus_stats_;
+	bool bus_stats_stored_ = false;
+
+	void EnsureIndexes() const;
+	void BuildStopBusesIndex() const;
+	void BuildSortedIds() const;
+	void BuildRoadDistancesIndex() const;
+	void BuildRouteLegsIndex() const;
+	void BuildBusStats() const;
+	BusStat CalculateBusStat(BusId id) const;
+	void CheckRouteLegs(BusId id) const;
+	int FindDistance(StopId from, StopId to) const;
+	StopId GetStopId(const Stop* stop) const;
 };
 
-} //namespace tr_cat
\ No newline at end of file
+} //namespace tr_cat
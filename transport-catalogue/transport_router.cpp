@@ -1,153 +1,471 @@
 #include "transport_router.h"
 
+#include <algorithm>
+#include <thread>
+
 using namespace std::string_literals;
+using namespace std::string_view_literals;
 
-//phase process_requests
-TransportRouter::TransportRouter(tr_cat::TransportCatalogue& catalogue, RouterSettings rout_set, RequestHandler& rh, 
-	graph::DirectedWeightedGraph<double>* graph_ptr, graph::Router<double>* router_ptr)
-	: catalogue_(catalogue)
-	, rout_set_(rout_set)
-	, rh_(rh )
-	, graph_ptr_(graph_ptr)
-	, router_ptr_(router_ptr)
+const int M_PER_KM = 1000;
+const int MIN_PER_HOUR = 60;
+
+// Заполняет описания вершин и рёбер индекса: при make_base вместе с рёбрами графа,
+// при process_requests - в том же порядке поверх графа из базы
+class RoutingIndex::Builder {
+public:
+	Builder(const tr_cat::TransportCatalogue& catalogue, const RouterSettings& rout_set, RoutingIndex& index)
+		: catalogue_(catalogue)
+		, rout_set_(rout_set)
+		, index_(index) {
+	}
+
+	void BuildGraph();
+	// возвращает число вершин остановок
+	size_t BuildStopVertexes();
+	void BuildEdgeInfos();
+
+private:
+	const tr_cat::TransportCatalogue& catalogue_;
+	const RouterSettings& rout_set_;
+	RoutingIndex& index_;
 
-{
-	BuildRouter();
+	// участок маршрута, по которому автобус едет в одну сторону, и расстояния его перегонов
+	struct RouteSegment {
+		tr_cat::TransportCatalogue::StopIdRange stops;
+		tr_cat::TransportCatalogue::DistanceRange legs;
+	};
+
+	// кольцевой маршрут - один участок, некольцевой - туда и обратно
+	std::vector<RouteSegment> GetRouteSegments(const Bus& bus) const;
+
+	void AddWaitEdges();
+	void ProcessRoute(const RouteSegment& segment, BusId bus_id);
+	void AddRouteEdges();
+	// модель ON_BOARD
+	void ProcessOnBoardRoute(const RouteSegment& segment, BusId bus_id, graph::VertexId first_on_board);
+	void AddOnBoardEdges(size_t stop_vertex_count);
+
+	void AddRouteEdgesPhase2();
+	void ProcessRoutePhase2(const RouteSegment& segment, BusId bus_id);
+};
+
+RoutingIndex::RoutingIndex(const tr_cat::TransportCatalogue& catalogue)
+	: catalogue_(catalogue) {
 }
 
-//phase make_base
-TransportRouter::TransportRouter(tr_cat::TransportCatalogue& catalogue, RouterSettings rout_set, RequestHandler& rh)
-	: catalogue_(catalogue)
-	, rout_set_(rout_set)
-	, rh_(rh) {
+std::shared_ptr<const RoutingIndex> RoutingIndex::Build(const tr_cat::TransportCatalogue& catalogue, const RouterSettings& rout_set,
+	const BusSchedules& schedules) {
+	auto index = std::make_shared<RoutingIndex>(catalogue);
+	Builder(catalogue, rout_set, *index).BuildGraph();
+	index->timetable_ = Timetable::Build(catalogue, rout_set.bus_wait_time_, rout_set.bus_velocity_, schedules);
+	return index;
+}
 
-	BuildGraph(catalogue_.CountStops() * 2);
+std::shared_ptr<const RoutingIndex> RoutingIndex::Load(const tr_cat::TransportCatalogue& catalogue, const RouterSettings& rout_set,
+	std::unique_ptr<Graph> graph, std::unique_ptr<Router> router, std::optional<std::vector<EdgeInfo>> edge_infos,
+	std::optional<Timetable::Data> timetable) {
+	auto index = std::make_shared<RoutingIndex>(catalogue);
+	index->graph_ = std::move(graph);
+	index->router_ = std::move(router);
+	index->timetable_ = timetable ? Timetable(catalogue, rout_set.bus_wait_time_, std::move(*timetable))
+		: Timetable::Build(catalogue, rout_set.bus_wait_time_, rout_set.bus_velocity_, {});
+	Builder builder(catalogue, rout_set, *index);
+	builder.BuildStopVertexes();
+	if (!edge_infos) {
+		builder.BuildEdgeInfos();
+		return index;
+	}
+	if (edge_infos->size() != index->graph_->GetEdgeCount()) {
+		throw std::invalid_argument("Edge infos don't match the graph");
+	}
+	for (const EdgeInfo& info : *edge_infos) {
+		const size_t id_limit = IsStopEdge(info.kind) ? static_cast<size_t>(catalogue.CountStops()) : catalogue.CountBuses();
+		if (info.id >= id_limit || info.kind > EdgeKind::ALIGHT) {
+			throw std::invalid_argument("Edge infos don't match the catalogue");
+		}
+	}
+	index->edge_infos_ = std::move(*edge_infos);
+	return index;
 }
 
-std::optional<std::vector<Item>> TransportRouter::FindRoute(std::string_view stop1, std::string_view stop2) {
-	if (!stops_to_vertexes_.count(stop1) || !stops_to_vertexes_.count(stop2)) {
+std::optional<std::vector<Item>> RoutingIndex::FindRoute(std::string_view stop1, std::string_view stop2) const {
+	const graph::VertexId from = FindStopVertex(stop1);
+	const graph::VertexId to = FindStopVertex(stop2);
+	if (from == NO_VERTEX || to == NO_VERTEX) {
 		return std::nullopt;
 	}
-	std::optional<graph::Router<double>::RouteInfo> best_route =
-		router_ptr_->BuildRoute(stops_to_vertexes_.at(stop1).second, stops_to_vertexes_.at(stop2).second);
+	std::optional<graph::Router<double>::RouteInfo> best_route = router_->BuildRoute(from, to);
 	if (!best_route) {
 		return std::nullopt;
 	}
+	return MakeItems(best_route->edges);
+}
+
+RouteMatrix RoutingIndex::BuildRouteMatrix(const std::vector<std::string_view>& from, const std::vector<std::string_view>& to,
+	bool with_items) const {
+	RouteMatrix matrix;
+	matrix.to_count = to.size();
+	matrix.times.resize(from.size() * to.size());
+	if (with_items) {
+		matrix.items.resize(matrix.times.size());
+	}
+	// неизвестные остановки не попадают в поиск, их столбцы остаются пустыми
+	std::vector<graph::VertexId> targets;
+	std::vector<size_t> target_columns;
+	for (size_t column = 0; column < to.size(); ++column) {
+		const graph::VertexId vertex = FindStopVertex(to[column]);
+		if (vertex != NO_VERTEX) {
+			targets.push_back(vertex);
+			target_columns.push_back(column);
+		}
+	}
+	if (targets.empty()) {
+		return matrix;
+	}
+	for (size_t row = 0; row < from.size(); ++row) {
+		const graph::VertexId source = FindStopVertex(from[row]);
+		if (source == NO_VERTEX) {
+			continue;
+		}
+		std::vector<std::optional<Router::RouteInfo>> routes = router_->BuildRoutes(source, targets, with_items);
+		for (size_t i = 0; i < routes.size(); ++i) {
+			if (!routes[i]) {
+				continue;
+			}
+			const size_t cell = row * to.size() + target_columns[i];
+			matrix.times[cell] = routes[i]->weight;
+			if (with_items) {
+				matrix.items[cell] = MakeItems(routes[i]->edges);
+			}
+		}
+	}
+	return matrix;
+}
+
+std::optional<std::vector<ReachedStop>> RoutingIndex::FindReachableStops(std::string_view stop, double max_time) const {
+	const graph::VertexId from = FindStopVertex(stop);
+	if (from == NO_VERTEX) {
+		return std::nullopt;
+	}
+	const std::vector<std::optional<double>> weights = router_->BuildReachableWeights(from, max_time);
+	std::vector<ReachedStop> result;
+	for (StopId stop_id = 0; stop_id < stop_vertexes_.size(); ++stop_id) {
+		if (stop_vertexes_[stop_id] != NO_VERTEX && weights[stop_vertexes_[stop_id]]) {
+			result.push_back(ReachedStop{ stop_id, *weights[stop_vertexes_[stop_id]] });
+		}
+	}
+	std::sort(result.begin(), result.end(), [this](const ReachedStop& lhs, const ReachedStop& rhs) {
+		if (lhs.time != rhs.time) {
+			return lhs.time < rhs.time;
+		}
+		return catalogue_.GetStopName(lhs.id) < catalogue_.GetStopName(rhs.id);
+	});
+	return result;
+}
+
+graph::VertexId RoutingIndex::FindStopVertex(std::string_view stop) const {
+	const std::optional<Stop*> found = catalogue_.FindStop(stop);
+	return found ? stop_vertexes_[(*found)->id] : NO_VERTEX;
+}
+
+std::vector<Item> RoutingIndex::MakeItems(const std::vector<graph::EdgeId>& edges) const {
 	std::vector<Item> result;
-	for (const auto edge_id : best_route.value().edges) {
-		result.push_back(edges_index_.at(edge_id));
+	result.reserve(edges.size());
+	bool on_board = false; //предыдущее ребро - перегон, следующий перегон продолжает ту же поездку
+	for (const auto edge_id : edges) {
+		const EdgeInfo& info = edge_infos_[edge_id];
+		const double time = graph_->GetEdge(edge_id).weight;
+		switch (info.kind) {
+		case EdgeKind::WAIT:
+			result.push_back(Item{ "Wait"sv, catalogue_.GetStopName(info.id), time, 0 });
+			break;
+		case EdgeKind::BUS:
+			result.push_back(Item{ "Bus"sv, catalogue_.GetBusName(info.id), time, static_cast<int>(info.span_count) });
+			break;
+		case EdgeKind::RIDE:
+			if (on_board) {
+				result.back().time += time;
+				result.back().span_count += static_cast<int>(info.span_count);
+			}
+			else {
+				result.push_back(Item{ "Bus"sv, catalogue_.GetBusName(info.id), time, static_cast<int>(info.span_count) });
+				on_board = true;
+			}
+			break;
+		case EdgeKind::ALIGHT:
+			on_board = false;
+			break;
+		}
 	}
 	return result;
 }
 
+std::optional<std::vector<Item>> RoutingIndex::FindRoute(std::string_view stop1, std::string_view stop2, double departure) const {
+	const std::optional<Stop*> from = catalogue_.FindStop(stop1);
+	const std::optional<Stop*> to = catalogue_.FindStop(stop2);
+	if (!from || !to || stop_vertexes_[(*from)->id] == NO_VERTEX || stop_vertexes_[(*to)->id] == NO_VERTEX) {
+		return std::nullopt;
+	}
+	std::optional<std::vector<Timetable::Leg>> legs = timetable_.FindRoute((*from)->id, (*to)->id, departure);
+	if (!legs) {
+		return std::nullopt;
+	}
+	std::vector<Item> result;
+	result.reserve(legs->size() * 2);
+	for (const Timetable::Leg& leg : *legs) {
+		result.push_back(Item{ "Wait"sv, catalogue_.GetStopName(leg.board_stop), leg.wait_time, 0 });
+		result.push_back(Item{ "Bus"sv, catalogue_.GetBusName(leg.bus), leg.ride_time, static_cast<int>(leg.span_count) });
+	}
+	return result;
+}
+
+const RoutingIndex::Graph& RoutingIndex::GetGraph() const {
+	return *graph_;
+}
+
+const RoutingIndex::Router& RoutingIndex::GetRouter() const {
+	return *router_;
+}
+
+const std::vector<EdgeInfo>& RoutingIndex::GetEdgeInfos() const {
+	return edge_infos_;
+}
+
+const Timetable& RoutingIndex::GetTimetable() const {
+	return timetable_;
+}
+
+RoutingIndex::MemoryUsage RoutingIndex::GetMemoryUsage() const {
+	MemoryUsage usage;
+	usage.graph = graph_->GetMemoryUsage();
+	usage.router = router_->GetMemoryUsage();
+	usage.edge_metadata = stop_vertexes_.capacity() * sizeof(graph::VertexId) + edge_infos_.capacity() * sizeof(EdgeInfo);
+	usage.timetable = timetable_.GetMemoryUsage();
+	return usage;
+}
+
+//phase make_base
+TransportRouter::TransportRouter(const tr_cat::TransportCatalogue& catalogue, RouterSettings rout_set, const BusSchedules& schedules)
+	: rout_set_(rout_set)
+	, index_(RoutingIndex::Build(catalogue, rout_set_, schedules)) {
+}
+
+//phase process_requests
+TransportRouter::TransportRouter(RouterSettings rout_set, std::shared_ptr<const RoutingIndex> index)
+	: rout_set_(rout_set)
+	, index_(std::move(index)) {
+}
+
+std::optional<std::vector<Item>> TransportRouter::FindRoute(std::string_view stop1, std::string_view stop2) const {
+	return index_->FindRoute(stop1, stop2);
+}
+
+std::optional<std::vector<Item>> TransportRouter::FindRoute(std::string_view stop1, std::string_view stop2, double departure) const {
+	return index_->FindRoute(stop1, stop2, departure);
+}
+
+RouteMatrix TransportRouter::BuildRouteMatrix(const std::vector<std::string_view>& from, const std::vector<std::string_view>& to,
+	bool with_items) const {
+	return index_->BuildRouteMatrix(from, to, with_items);
+}
+
+std::optional<std::vector<ReachedStop>> TransportRouter::FindReachableStops(std::string_view stop, double max_time) const {
+	return index_->FindReachableStops(stop, max_time);
+}
+
 tc_serialize::Graph TransportRouter::GetSerializedGraph() const {
-	return graph_ptr_->SerializeGraph();
+	return index_->GetGraph().SerializeGraph();
 }
 
 tc_serialize::Router TransportRouter::GetSerializedRouter() const {
-	return router_ptr_->SerializeRouter();
+	return index_->GetRouter().SerializeRouter();
+}
+
+size_t TransportRouter::GetRouterMemoryUsage() const {
+	return index_->GetRouter().GetMemoryUsage();
+}
+
+const graph::DirectedWeightedGraph<double>& TransportRouter::GetGraph() const {
+	return index_->GetGraph();
+}
+
+const graph::Router<double>& TransportRouter::GetRouter() const {
+	return index_->GetRouter();
+}
+
+const std::shared_ptr<const RoutingIndex>& TransportRouter::GetIndex() const {
+	return index_;
+}
+
+// остановки с автобусами по возрастанию имён получают вершины 2k (отправление) и 2k + 1 (прибытие),
+// в модели ON_BOARD - вершину k
+size_t RoutingIndex::Builder::BuildStopVertexes() {
+	index_.stop_vertexes_.assign(catalogue_.CountStops(), NO_VERTEX);
+	const bool on_board = rout_set_.graph_model_ == GraphModel::ON_BOARD;
+	graph::VertexId from = on_board ? 0 : 1;
+	for (StopId stop_id : catalogue_.GetSortedStopIds()) {
+		if (const auto buses = catalogue_.GetBusesForStop(stop_id); buses.begin() != buses.end()) {
+			index_.stop_vertexes_[stop_id] = from;
+			from += on_board ? 1 : 2;
+		}
+	}
+	return on_board ? from : catalogue_.CountStops() * 2;
 }
 
 //phase make_base
-void TransportRouter::AddWaitEdges() {
-	const std::map <std::string_view, Stop*> stops = rh_.GetAllStopsWithBusesAndSorted();
-	graph::VertexId from = 1;
-	graph::VertexId to = 0;
-	for (const auto& [name, ptr] : stops) {
-		graph::Edge<double> edge{ from, to, rout_set_.bus_wait_time_ };
-		stops_to_vertexes_.insert({ name, {to, from} });
-		size_t index = graph_ptr_->AddEdge(edge);
-		from += 2;
-		to += 2;
+void RoutingIndex::Builder::AddWaitEdges() {
+	for (StopId stop_id : catalogue_.GetSortedStopIds()) {
+		const graph::VertexId from = index_.stop_vertexes_[stop_id];
+		if (from == NO_VERTEX) {
+			continue;
+		}
+		index_.graph_->AddEdge(graph::Edge<double>{ from, from - 1, rout_set_.bus_wait_time_ });
+		index_.edge_infos_.push_back(EdgeInfo{ static_cast<uint32_t>(stop_id), 0, EdgeKind::WAIT });
 	}
 }
 
+std::vector<RoutingIndex::Builder::RouteSegment> RoutingIndex::Builder::GetRouteSegments(const Bus& bus) const {
+	const tr_cat::TransportCatalogue::StopIdRange stops = catalogue_.GetRouteStops(bus.id);
+	const tr_cat::TransportCatalogue::DistanceRange legs = catalogue_.GetRouteLegDistances(bus.id);
+	if (bus.is_round) {
+		return { RouteSegment{ stops, legs } };
+	}
+	// маршрут хранится как половина и она же в обратном порядке, половины делят разворотную остановку
+	const size_t half = bus.half_route.size();
+	if (half == 0) {
+		return {};
+	}
+	return {
+		RouteSegment{ { stops.begin(), stops.begin() + half }, { legs.begin(), legs.begin() + half - 1 } },
+		RouteSegment{ { stops.begin() + half - 1, stops.end() }, { legs.begin() + half - 1, legs.end() } },
+	};
+}
+
 //phase make_base
-void TransportRouter::ProcessRoute(std::vector<Stop*>& route, std::string_view bus_name) {
-	for (int i = 0; i + 1 < route.size(); ++i) {
-		graph::VertexId from = stops_to_vertexes_.at(route[i]->name).first;
-		Stop* prev_stop = route[i];
+void RoutingIndex::Builder::ProcessRoute(const RouteSegment& segment, BusId bus_id) {
+	const StopId* route = segment.stops.begin();
+	const int* legs = segment.legs.begin();
+	const int stop_count = static_cast<int>(segment.stops.end() - route);
+	for (int i = 0; i + 1 < stop_count; ++i) {
+		graph::VertexId from = index_.stop_vertexes_[route[i]] - 1;
 		double adding_time = 0.;
-		for (int j = i + 1; j < route.size(); ++j) {
-			graph::VertexId to = stops_to_vertexes_.at(route[j]->name).second;
-			adding_time += (catalogue_.GetDistanceBtwStops(prev_stop, route[j]) * 60) / (rout_set_.bus_velocity_ * 1000);
-			graph::Edge<double> edge{ from, to, adding_time };
-			size_t index = graph_ptr_->AddEdge(edge);
-			prev_stop = route[j];
+		for (int j = i + 1; j < stop_count; ++j) {
+			graph::VertexId to = index_.stop_vertexes_[route[j]];
+			adding_time += (legs[j - 1] * MIN_PER_HOUR) / (rout_set_.bus_velocity_ * M_PER_KM);
+			index_.graph_->AddEdge(graph::Edge<double>{ from, to, adding_time });
+			index_.edge_infos_.push_back(EdgeInfo{ static_cast<uint32_t>(bus_id), static_cast<uint32_t>(j - i), EdgeKind::BUS });
 		}
 	}
 }
 
 //phase make_base
-void TransportRouter::AddRouteEdges() {
-	const std::map<std::string_view, Bus*> buses = rh_.GetAllBusesWithRoutesAndSorted();
-	for (const auto& [name, ptr] : buses) {
-		if (ptr->is_round) {
-			ProcessRoute(ptr->route, name);
+void RoutingIndex::Builder::AddRouteEdges() {
+	for (BusId bus_id : catalogue_.GetSortedBusIds()) {
+		const Bus& bus = *catalogue_.GetBus(bus_id);
+		if (bus.route.empty()) {
+			continue;
 		}
-		else {
-			ProcessRoute(ptr->half_route, name);
-			std::vector<Stop*> second_half = { ptr->half_route.rbegin(), ptr->half_route.rend() };
-			ProcessRoute(second_half, name);
+		for (const RouteSegment& segment : GetRouteSegments(bus)) {
+			ProcessRoute(segment, bus_id);
 		}
 	}
 }
 
-void TransportRouter::BuildGraph(size_t size) {
-	graph_ptr_ = new graph::DirectedWeightedGraph<double>(size);
-	AddWaitEdges();
-	AddRouteEdges();
-	router_ptr_ = new graph::Router<double>(*graph_ptr_);
+//phase make_base, модель ON_BOARD. Вершины "в автобусе" first_on_board + i по остановкам участка.
+//Посадки нет на последней остановке участка, высадки - на первой
+void RoutingIndex::Builder::ProcessOnBoardRoute(const RouteSegment& segment, BusId bus_id, graph::VertexId first_on_board) {
+	const StopId* route = segment.stops.begin();
+	const int* legs = segment.legs.begin();
+	const int stop_count = static_cast<int>(segment.stops.end() - route);
+	for (int i = 0; i < stop_count; ++i) {
+		const graph::VertexId stop_vertex = index_.stop_vertexes_[route[i]];
+		const graph::VertexId on_board = first_on_board + i;
+		if (i + 1 < stop_count) {
+			index_.graph_->AddEdge(graph::Edge<double>{ stop_vertex, on_board, rout_set_.bus_wait_time_ });
+			index_.edge_infos_.push_back(EdgeInfo{ static_cast<uint32_t>(route[i]), 0, EdgeKind::WAIT });
+			const double time = (legs[i] * MIN_PER_HOUR) / (rout_set_.bus_velocity_ * M_PER_KM);
+			index_.graph_->AddEdge(graph::Edge<double>{ on_board, on_board + 1, time });
+			index_.edge_infos_.push_back(EdgeInfo{ static_cast<uint32_t>(bus_id), 1, EdgeKind::RIDE });
+		}
+		if (i > 0) {
+			index_.graph_->AddEdge(graph::Edge<double>{ on_board, stop_vertex, 0. });
+			index_.edge_infos_.push_back(EdgeInfo{ static_cast<uint32_t>(route[i]), 0, EdgeKind::ALIGHT });
+		}
+	}
 }
 
-void TransportRouter::BuildRouter() {
-	AddWaitEdgesPhase2();
-	AddRouteEdgesPhase2();
-	
+//phase make_base, модель ON_BOARD
+void RoutingIndex::Builder::AddOnBoardEdges(size_t stop_vertex_count) {
+	std::vector<std::pair<BusId, RouteSegment>> segments;
+	size_t vertex_count = stop_vertex_count;
+	for (BusId bus_id : catalogue_.GetSortedBusIds()) {
+		const Bus& bus = *catalogue_.GetBus(bus_id);
+		if (bus.route.empty()) {
+			continue;
+		}
+		for (const RouteSegment& segment : GetRouteSegments(bus)) {
+			segments.emplace_back(bus_id, segment);
+			vertex_count += segment.stops.end() - segment.stops.begin();
+		}
+	}
+	index_.graph_ = std::make_unique<Graph>(vertex_count);
+	graph::VertexId first_on_board = stop_vertex_count;
+	for (const auto& [bus_id, segment] : segments) {
+		ProcessOnBoardRoute(segment, bus_id, first_on_board);
+		first_on_board += segment.stops.end() - segment.stops.begin();
+	}
 }
 
-//phase process_requests
-void TransportRouter::AddWaitEdgesPhase2() {
-	const std::map <std::string_view, Stop*> stops = rh_.GetAllStopsWithBusesAndSorted();
-	graph::VertexId from = 1;
-	graph::VertexId to = 0;
-	for (const auto& [name, ptr] : stops) {
-		stops_to_vertexes_.insert({ name, {to, from} });
-		Item item{ "Wait"s, name, rout_set_.bus_wait_time_ , 0 };
-		edges_index_[des_index_++] = std::move(item);
-		from += 2;
-		to += 2;
+void RoutingIndex::Builder::BuildGraph() {
+	const size_t stop_vertex_count = BuildStopVertexes();
+	if (rout_set_.graph_model_ == GraphModel::ON_BOARD) {
+		AddOnBoardEdges(stop_vertex_count);
+	}
+	else {
+		index_.graph_ = std::make_unique<Graph>(stop_vertex_count);
+		AddWaitEdges();
+		AddRouteEdges();
+	}
+	size_t build_threads = rout_set_.build_threads_;
+	if (build_threads == 0) {
+		build_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	index_.router_ = std::make_unique<Router>(*index_.graph_, rout_set_.router_engine_, build_threads);
+}
+
+//phase process_requests, базы без описаний рёбер
+void RoutingIndex::Builder::BuildEdgeInfos() {
+	index_.edge_infos_.reserve(index_.graph_->GetEdgeCount());
+	for (StopId stop_id : catalogue_.GetSortedStopIds()) {
+		if (index_.stop_vertexes_[stop_id] != NO_VERTEX) {
+			index_.edge_infos_.push_back(EdgeInfo{ static_cast<uint32_t>(stop_id), 0, EdgeKind::WAIT });
+		}
+	}
+	AddRouteEdgesPhase2();
+	if (index_.edge_infos_.size() != index_.graph_->GetEdgeCount()) {
+		throw std::invalid_argument("Graph of the base doesn't match the catalogue");
 	}
 }
 
 //phase process_requests
-void TransportRouter::AddRouteEdgesPhase2() {
-	const std::map<std::string_view, Bus*> buses = rh_.GetAllBusesWithRoutesAndSorted();
-	for (const auto& [name, ptr] : buses) {
-		if (ptr->is_round) {
-			ProcessRoutePhase2(ptr->route, name);
+void RoutingIndex::Builder::AddRouteEdgesPhase2() {
+	for (BusId bus_id : catalogue_.GetSortedBusIds()) {
+		const Bus& bus = *catalogue_.GetBus(bus_id);
+		if (bus.route.empty()) {
+			continue;
 		}
-		else {
-			ProcessRoutePhase2(ptr->half_route, name);
-			std::vector<Stop*> second_half = { ptr->half_route.rbegin(), ptr->half_route.rend() };
-			ProcessRoutePhase2(second_half, name);
+		for (const RouteSegment& segment : GetRouteSegments(bus)) {
+			ProcessRoutePhase2(segment, bus_id);
 		}
 	}
 }
 
-const int M_PER_KM = 1000;
-const int MIN_PER_HOUR = 60;
-
 //phase process_requests
-void TransportRouter::ProcessRoutePhase2(std::vector<Stop*>& route, std::string_view bus_name) {
-	for (int i = 0; i + 1 < route.size(); ++i) {
-		Stop* prev_stop = route[i];
-		double adding_time = 0.;
-		for (int j = i + 1; j < route.size(); ++j) {
-			adding_time += (catalogue_.GetDistanceBtwStops(prev_stop, route[j]) * MIN_PER_HOUR) / (rout_set_.bus_velocity_ * M_PER_KM);
-			Item item{ "Bus"s, bus_name, adding_time, j - i };
-			edges_index_[des_index_++] = std::move(item);
-			prev_stop = route[j];
+void RoutingIndex::Builder::ProcessRoutePhase2(const RouteSegment& segment, BusId bus_id) {
+	const int stop_count = static_cast<int>(segment.stops.end() - segment.stops.begin());
+	for (int i = 0; i + 1 < stop_count; ++i) {
+		for (int j = i + 1; j < stop_count; ++j) {
+			index_.edge_infos_.push_back(EdgeInfo{ static_cast<uint32_t>(bus_id), static_cast<uint32_t>(j - i), EdgeKind::BUS });
 		}
 	}
 }
@@ -164,5 +482,41 @@ tc_serialize::RouterSettings TransportRouter::SerializeSettings() const {
 	tc_serialize::RouterSettings settings;
 	settings.set_bus_velocity(rout_set_.bus_velocity_);
 	settings.set_bus_wait_time(rout_set_.bus_wait_time_);
+	settings.set_router_engine(static_cast<tc_serialize::RouterEngine>(rout_set_.router_engine_));
+	settings.set_graph_model(static_cast<tc_serialize::GraphModel>(rout_set_.graph_model_));
 	return settings;
+}
+
+std::optional<graph::RouterEngine> ParseRouterEngine(std::string_view engine_name) {
+	if (engine_name == "all_pairs"sv) {
+		return graph::RouterEngine::ALL_PAIRS;
+	}
+	if (engine_name == "dijkstra"sv) {
+		return graph::RouterEngine::DIJKSTRA;
+	}
+	if (engine_name == "contraction_hierarchy"sv) {
+		return graph::RouterEngine::CONTRACTION_HIERARCHY;
+	}
+	return std::nullopt;
+}
+
+std::string_view RouterEngineName(graph::RouterEngine engine) {
+	switch (engine) {
+	case graph::RouterEngine::DIJKSTRA:
+		return "dijkstra"sv;
+	case graph::RouterEngine::CONTRACTION_HIERARCHY:
+		return "contraction_hierarchy"sv;
+	default:
+		return "all_pairs"sv;
+	}
+}
+
+std::optional<GraphModel> ParseGraphModel(std::string_view model_name) {
+	if (model_name == "span_edges"sv) {
+		return GraphModel::SPAN_EDGES;
+	}
+	if (model_name == "on_board"sv) {
+		return GraphModel::ON_BOARD;
+	}
+	return std::nullopt;
 }
\ No newline at end of file
@@ -3,65 +3,177 @@
 #include "transport_catalogue.h"
 #include "graph.h"
 #include "router.h"
-#include "request_handler.h"
+#include "timetable.h"
 
 #include <graph.pb.h>
 #include <transport_router.pb.h>
 
-#include <unordered_map>
+#include <cstdint>
+#include <limits>
+#include <memory>
 #include <string_view>
 #include <string>
 #include <vector>
 #include <optional>
 
+// Как автобусы представлены в графе. SPAN_EDGES: ребро от каждой остановки маршрута до каждой следующей,
+// их число квадратично по длине маршрута. ON_BOARD: у каждой остановки маршрута своя вершина "в автобусе",
+// соседние связаны рёбрами перегонов, а с вершиной остановки - рёбрами посадки (время ожидания) и высадки;
+// рёбер линейное число, зато вершин больше, поэтому с all_pairs на больших сетях лучше не сочетать
+enum class GraphModel {
+	SPAN_EDGES,
+	ON_BOARD,
+};
+
 struct RouterSettings {
 	double bus_wait_time_ = 0.0;
 	double bus_velocity_ = 0.0;
+	graph::RouterEngine router_engine_ = graph::RouterEngine::ALL_PAIRS;
+	GraphModel graph_model_ = GraphModel::SPAN_EDGES;
+	size_t build_threads_ = 1; //only make_base, 0 - по числу ядер
 };
 
 struct Item {
-	std::string type;
+	std::string_view type; //"Wait" или "Bus"
 	std::string_view name;
 	double time = 0.;
 	int span_count = 0; //для типа Wait не заполняем
 };
 
+enum class EdgeKind : uint8_t {
+	WAIT,
+	BUS,
+	RIDE,
+	ALIGHT,
+};
+
+// Ребро графа: ожидание на остановке id (в модели ON_BOARD - посадка), поездка на автобусе id через
+// span_count перегонов, перегон автобуса id в модели ON_BOARD или высадка на остановке id.
+// Время - вес ребра в графе
+struct EdgeInfo {
+	uint32_t id = 0;
+	uint32_t span_count = 0;
+	EdgeKind kind = EdgeKind::WAIT;
+};
+
+// id ребра - остановка, иначе автобус
+inline bool IsStopEdge(EdgeKind kind) {
+	return kind == EdgeKind::WAIT || kind == EdgeKind::ALIGHT;
+}
+
+// Маршруты из каждой остановки from в каждую остановку to, по строкам: индекс from * to_count + индекс to.
+// nullopt - маршрута нет или остановка неизвестна; items заполняются, только если запрошены
+struct RouteMatrix {
+	size_t to_count = 0;
+	std::vector<std::optional<double>> times;
+	std::vector<std::vector<Item>> items;
+};
+
+// остановка, до которой можно доехать за time минут
+struct ReachedStop {
+	StopId id = 0;
+	double time = 0.;
+};
+
+// Неизменяемый индекс маршрутизации: граф, маршрутизатор над ним, описания вершин и рёбер и расписание.
+// После построения только читается, поэтому один экземпляр через std::shared_ptr<const RoutingIndex>
+// делят любые потоки без блокировок. Индекс ссылается на справочник, тот должен жить дольше
+class RoutingIndex {
+public:
+	using Graph = graph::DirectedWeightedGraph<double>;
+	using Router = graph::Router<double>;
+
+	static constexpr graph::VertexId NO_VERTEX = std::numeric_limits<graph::VertexId>::max();
+
+	explicit RoutingIndex(const tr_cat::TransportCatalogue& catalogue);
+
+	// phase make_base: граф, маршрутизатор и расписание строятся по справочнику
+	static std::shared_ptr<const RoutingIndex> Build(const tr_cat::TransportCatalogue& catalogue, const RouterSettings& rout_set,
+		const BusSchedules& schedules = {});
+	// phase process_requests: граф и маршрутизатор из базы, router построен над *graph.
+	// Описания рёбер и расписание берутся из базы, а в базах без них восстанавливаются по справочнику
+	// (расписание - без расписаний автобусов); std::invalid_argument, если они не подходят к графу
+	static std::shared_ptr<const RoutingIndex> Load(const tr_cat::TransportCatalogue& catalogue, const RouterSettings& rout_set,
+		std::unique_ptr<Graph> graph, std::unique_ptr<Router> router, std::optional<std::vector<EdgeInfo>> edge_infos,
+		std::optional<Timetable::Data> timetable);
+
+	std::optional<std::vector<Item>> FindRoute(std::string_view stop1, std::string_view stop2) const;
+	// по расписанию с отправлением в departure (минуты от полуночи), время ожидания - до ближайшего рейса
+	std::optional<std::vector<Item>> FindRoute(std::string_view stop1, std::string_view stop2, double departure) const;
+	// остановки разрешаются один раз, на каждую остановку from - один Router::BuildRoutes
+	RouteMatrix BuildRouteMatrix(const std::vector<std::string_view>& from, const std::vector<std::string_view>& to, bool with_items) const;
+	// остановки, до которых из stop не дольше max_time, включая её саму, по возрастанию времени, при равном - имени;
+	// один поиск или одна строка таблицы all_pairs. nullopt, если остановки нет или через неё не ходят автобусы
+	std::optional<std::vector<ReachedStop>> FindReachableStops(std::string_view stop, double max_time) const;
+
+	const Graph& GetGraph() const;
+	const Router& GetRouter() const;
+	// по EdgeId
+	const std::vector<EdgeInfo>& GetEdgeInfos() const;
+	const Timetable& GetTimetable() const;
+
+	// байты в куче; части графа и таблицы маршрутов, отображённые из файла базы, не считаются:
+	// их страницы общие для всех процессов, открывших ту же базу
+	struct MemoryUsage {
+		size_t graph = 0;
+		size_t router = 0;
+		size_t edge_metadata = 0;
+		size_t timetable = 0;
+	};
+
+	MemoryUsage GetMemoryUsage() const;
+
+private:
+	class Builder;
+
+	const tr_cat::TransportCatalogue& catalogue_;
+	std::unique_ptr<Graph> graph_;
+	std::unique_ptr<Router> router_;
+
+	// по id остановки: вершина, где начинаются и заканчиваются маршруты; NO_VERTEX у остановок без автобусов.
+	// SPAN_EDGES: нечётная вершина прибытия, из неё ребро ожидания ведёт в чётную вершину отправления
+	// на единицу меньше. ON_BOARD: одна вершина на остановку, за ними идут вершины "в автобусе"
+	std::vector<graph::VertexId> stop_vertexes_;
+	std::vector<EdgeInfo> edge_infos_;
+	Timetable timetable_;
+
+	// NO_VERTEX, если остановки нет или через неё не ходят автобусы
+	graph::VertexId FindStopVertex(std::string_view stop) const;
+	std::vector<Item> MakeItems(const std::vector<graph::EdgeId>& edges) const;
+};
+
 class TransportRouter {
     
 public:
-	TransportRouter(tr_cat::TransportCatalogue& catalogue, RouterSettings rout_set, RequestHandler& rh);
-
-	TransportRouter(tr_cat::TransportCatalogue& catalogue, RouterSettings rout_set, RequestHandler& rh,
-		graph::DirectedWeightedGraph<double>* graph_ptr, graph::Router<double>* router_ptr);
+	//phase make_base
+	TransportRouter(const tr_cat::TransportCatalogue& catalogue, RouterSettings rout_set, const BusSchedules& schedules = {});
+	//phase process_requests
+	TransportRouter(RouterSettings rout_set, std::shared_ptr<const RoutingIndex> index);
 
-	std::optional<std::vector<Item>> FindRoute(std::string_view stop1, std::string_view stop2);
+	std::optional<std::vector<Item>> FindRoute(std::string_view stop1, std::string_view stop2) const;
+	std::optional<std::vector<Item>> FindRoute(std::string_view stop1, std::string_view stop2, double departure) const;
+	RouteMatrix BuildRouteMatrix(const std::vector<std::string_view>& from, const std::vector<std::string_view>& to, bool with_items) const;
+	std::optional<std::vector<ReachedStop>> FindReachableStops(std::string_view stop, double max_time) const;
 
 	tc_serialize::Graph GetSerializedGraph() const;
 	tc_serialize::Router GetSerializedRouter() const;
 	tc_serialize::TransportRouter GetSerializedTransportRouter() const;
 
+	size_t GetRouterMemoryUsage() const;
+
+	const graph::DirectedWeightedGraph<double>& GetGraph() const;
+	const graph::Router<double>& GetRouter() const;
+	const std::shared_ptr<const RoutingIndex>& GetIndex() const;
+
 private:
-	tr_cat::TransportCatalogue& catalogue_;
 	RouterSettings rout_set_;
-	RequestHandler& rh_;
-	graph::DirectedWeightedGraph<double>* graph_ptr_ = nullptr;
-	graph::Router<double>* router_ptr_ = nullptr;
-
-	size_t des_index_ = 0;
-
-	//common case: even(.first) = from, odd(.second) = to; wait edges: even = to, odd = from
-	std::unordered_map<std::string_view, std::pair<size_t, size_t>> stops_to_vertexes_;
-	std::unordered_map<size_t, Item> edges_index_;
-
-	void AddWaitEdges();
-	void ProcessRoute(std::vector<Stop*>& route, std::string_view bus_name);
-	void AddRouteEdges();
-	void BuildGraph(size_t size);
-	
-	void BuildRouter();
-	void AddWaitEdgesPhase2();
-	void AddRouteEdgesPhase2();
-	void ProcessRoutePhase2(std::vector<Stop*>& route, std::string_view bus_name);
+	std::shared_ptr<const RoutingIndex> index_;
 
 	tc_serialize::RouterSettings SerializeSettings() const;
-};
\ No newline at end of file
+};
+
+std::optional<graph::RouterEngine> ParseRouterEngine(std::string_view engine_name);
+
+std::string_view RouterEngineName(graph::RouterEngine engine);
+
+std::optional<GraphModel> ParseGraphModel(std::string_view model_name);
\ No newline at end of file